@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+# Compare kmeans_simple with and without the --grid centroid index on s1 and the Jutland 400k set
+# Build first with: make kmeans_simple
+# Usage: grid_bench.sh [runs] (clusters, iterations etc from the usual KMEANS_ environment)
+# The Jutland data is zipped in data/ so unzip it first.
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+runs=${1:-3}
+max_iterations=${KMEANS_MAX_ITERATIONS:-200}
+max_points=${KMEANS_MAX_POINTS:-1000000}
+report_name=${KMEANS_REPORT:-grid_metrics.csv}
+
+mkdir -p ${KMEANS_METRICS_DIR}
+metrics_file=${KMEANS_METRICS_DIR}/${report_name}
+
+# input file and number of clusters for each dataset
+for dataset in s1.csv:15 jutland_400k.csv:22; do
+  infile=${dataset%%:*}
+  clusters=${KMEANS_CLUSTERS:-${dataset##*:}}
+  for ((run=1; run<=runs; run++)) do
+    for option in "" --grid; do
+      command="${KMEANS_BIN_DIR}/kmeans_simple --warn -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} \
+        -i ${max_iterations} -n ${max_points} -m ${metrics_file} -l simple${option/--/_}_${infile} ${option}"
+      echo "running: $command"
+      ${command} > /dev/null
+    done
+  done
+done
+
+echo "Mean total and assignment seconds over ${runs} runs:"
+awk -F, 'NR > 1 { total[$1] += $3; assignment[$1] += $4; count[$1]++ }
+         END { for (label in total) printf "%-40s %12f %12f\n", label, total[label] / count[label], assignment[label] / count[label] }' \
+    ${metrics_file} | sort
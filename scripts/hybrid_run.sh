@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# Run the hybrid MPI + OpenMP program with one process per socket and threads for the cores
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+processes=${1:-${KMEANS_PROCESSES:-1}}
+threads=${2:-${KMEANS_THREADS:-1}}
+
+debug_level=${KMEANS_DEBUG:-debug}
+infile=${KMEANS_IN:-six_points.csv}
+testfile=${KMEANS_TEST:-six_points_clustered_csv}
+clusters=${KMEANS_CLUSTERS:-3}
+max_iterations=${KMEANS_MAX_ITERATIONS:-20}
+max_points=${KMEANS_MAX_POINTS:-10}
+program=${KMEANS_PROGRAM:-kmeans_hybrid}
+# one process per socket, bound to the socket so its threads stay on the cores of that socket
+mpi_extras="${MPI_EXTRAS:-} --map-by ppr:1:socket --bind-to socket"
+echo "Running ${program} with $processes processes and ${threads} threads per process"
+echo "with -k ${clusters} and input from ${infile} with debug level ${debug_level}"
+command="mpirun -n ${processes} ${mpi_extras} -x OMP_PROC_BIND=close ${KMEANS_BIN_DIR}/${program} --${debug_level} \
+ -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} -i ${max_iterations} -n ${max_points} \
+ --threads ${threads} -t ${KMEANS_TEST_DIR}/${testfile}"
+echo "running: $command"
+${command}
+echo "finished: $command"
@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+# Compare the first-K initialization with --init kmeans++ for several seeds: iterations used,
+# iterations saved and seconds (the init_method and init_seconds columns of the metrics).
+# Build first with: make kmeans_simple
+# Usage: init_bench.sh [seeds...] (input, clusters etc from the usual KMEANS_ environment)
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+seeds=${@:-42}
+infile=${KMEANS_IN:-s1.csv}
+clusters=${KMEANS_CLUSTERS:-15}
+max_iterations=${KMEANS_MAX_ITERATIONS:-10000}
+max_points=${KMEANS_MAX_POINTS:-1000000}
+report_name=${KMEANS_REPORT:-init_metrics.csv}
+
+mkdir -p ${KMEANS_METRICS_DIR}
+metrics_file=${KMEANS_METRICS_DIR}/${report_name}
+
+run() {
+  command="${KMEANS_BIN_DIR}/kmeans_simple --warn -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} \
+    -i ${max_iterations} -n ${max_points} -m ${metrics_file} $*"
+  echo "running: $command"
+  ${command} > /dev/null
+}
+
+run -l first_${infile}
+for seed in ${seeds}; do
+  run -l kmeans++_seed${seed}_${infile} --init kmeans++ --seed ${seed}
+done
+
+echo "Iterations (saved against first-K), total seconds and init seconds:"
+awk -F, 'NR > 1 && $13 == "first" { first = $2 }
+         NR > 1 { label[NR] = $1; iterations[NR] = $2; total[NR] = $3; init[NR] = $14 }
+         END { for (row in label) printf "%-40s %6d %6d %12f %12f\n", label[row], iterations[row],
+                                         first - iterations[row], total[row], init[row] }' ${metrics_file}
@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+# Compare kmeans_simple (all log levels compiled in) with kmeans_simple_info
+# (verbose, debug and trace compiled out with -DKMEANS_MAX_LOG_LEVEL=info) over several runs.
+# Build both first with: make kmeans_simple kmeans_simple_info
+# Usage: log_ceiling_bench.sh [runs] (input, clusters etc from the usual KMEANS_ environment)
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+runs=${1:-5}
+infile=${KMEANS_IN:-s1.csv}
+clusters=${KMEANS_CLUSTERS:-15}
+max_iterations=${KMEANS_MAX_ITERATIONS:-200}
+max_points=${KMEANS_MAX_POINTS:-1000000}
+report_name=${KMEANS_REPORT:-log_ceiling_metrics.csv}
+
+mkdir -p ${KMEANS_METRICS_DIR}
+metrics_file=${KMEANS_METRICS_DIR}/${report_name}
+
+for ((run=1; run<=runs; run++)) do
+  for program in kmeans_simple kmeans_simple_info; do
+    # run at warn level so the only difference is whether the debug/trace checks are compiled in
+    command="${KMEANS_BIN_DIR}/${program} --warn -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} \
+      -i ${max_iterations} -n ${max_points} -m ${metrics_file} -l ${program}_${infile}"
+    echo "running: $command"
+    ${command} > /dev/null
+  done
+done
+
+echo "Mean total seconds over ${runs} runs:"
+awk -F, 'NR > 1 { total[$1] += $3; count[$1]++ }
+         END { for (label in total) printf "%-40s %f\n", label, total[label] / count[label] }' ${metrics_file}
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Compare kmeans_minibatch for several batch sizes with the full kmeans_simple: total seconds and
+# final inertia (the inertia column of the metrics), both seeded with --init kmeans++
+# Build first with: make kmeans_simple kmeans_minibatch
+# Usage: minibatch_bench.sh [batch sizes...] (input, clusters etc from the usual KMEANS_ environment)
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+batch_sizes=${@:-256 1024 4096}
+infile=${KMEANS_IN:-jutland_400k.csv}
+clusters=${KMEANS_CLUSTERS:-22}
+max_iterations=${KMEANS_MAX_ITERATIONS:-200}
+max_points=${KMEANS_MAX_POINTS:-1000000}
+report_name=${KMEANS_REPORT:-minibatch_metrics.csv}
+
+mkdir -p ${KMEANS_METRICS_DIR}
+metrics_file=${KMEANS_METRICS_DIR}/${report_name}
+
+run() {
+  program=$1; shift
+  command="${KMEANS_BIN_DIR}/${program} --warn -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} \
+    -i ${max_iterations} -n ${max_points} -m ${metrics_file} --init kmeans++ $*"
+  echo "running: $command"
+  ${command} > /dev/null
+}
+
+run kmeans_simple -l simple_${infile}
+for batch_size in ${batch_sizes}; do
+  run kmeans_minibatch -l minibatch${batch_size}_${infile} --batch-size ${batch_size}
+done
+
+echo "Iterations, total seconds, inertia and inertia relative to the full engine:"
+awk -F, 'NR > 1 && $1 ~ /^simple_/ { full = $15 }
+         NR > 1 { label[NR] = $1; iterations[NR] = $2; total[NR] = $3; inertia[NR] = $15 }
+         END { for (row in label) printf "%-40s %6d %12f %16f %8.4f\n", label[row], iterations[row],
+                                         total[row], inertia[row], (full > 0 ? inertia[row] / full : 0) }' ${metrics_file}
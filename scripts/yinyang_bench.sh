@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# Compare kmeans_simple with kmeans_yinyang as the number of clusters grows (K = 15, 64, 256, 1024)
+# Build both first with: make kmeans_simple kmeans_yinyang
+# Usage: yinyang_bench.sh [runs] (input, iterations etc from the usual KMEANS_ environment)
+# The Jutland data is zipped in data/ so unzip it first for the default input.
+current_dir=$( cd "$( dirname ${BASH_SOURCE[0]} )" && pwd )
+source ${current_dir}/set_env.sh
+
+runs=${1:-1}
+infile=${KMEANS_IN:-jutland_400k.csv}
+max_iterations=${KMEANS_MAX_ITERATIONS:-100}
+max_points=${KMEANS_MAX_POINTS:-1000000}
+report_name=${KMEANS_REPORT:-yinyang_metrics.csv}
+cluster_counts=${KMEANS_CLUSTER_COUNTS:-"15 64 256 1024"}
+
+mkdir -p ${KMEANS_METRICS_DIR}
+metrics_file=${KMEANS_METRICS_DIR}/${report_name}
+
+for ((run=1; run<=runs; run++)) do
+  for clusters in ${cluster_counts}; do
+    for program in kmeans_simple kmeans_yinyang; do
+      command="${KMEANS_BIN_DIR}/${program} --warn -f ${KMEANS_DATA_DIR}/${infile} -k ${clusters} \
+        -i ${max_iterations} -n ${max_points} -m ${metrics_file} -l ${program}_k${clusters}"
+      echo "running: $command"
+      ${command} > /dev/null
+    done
+  done
+done
+
+echo "Mean total and assignment seconds over ${runs} runs:"
+awk -F, 'NR > 1 { total[$1] += $3; assignment[$1] += $4; count[$1]++ }
+         END { for (label in total) printf "%-30s %12f %12f\n", label, total[label] / count[label], assignment[label] / count[label] }' \
+    ${metrics_file} | sort -t k -k 3 -n
@@ -2,21 +2,78 @@
 #include "kmeans.h"
 #include "kmeans_support.h"
 #include "kmeans_impl.h"
+#include "kmeans_csv.h"
+#include "kmeans_binary.h"
 #include "log.h"
 
 static char* headers[3];
 static int dimensions;
+static double load_seconds; // time taken by load_dataset, reported in the metrics
 struct kmeans_config *kmeans_config;
 enum log_level_t log_level;
 
 int load_dataset(struct pointset *dataset)
 {
     char *csv_file_name = valid_file('f', kmeans_config->in_file);
-    int num_points = read_csv_file(csv_file_name, dataset, kmeans_config->max_points, headers, &dimensions);
+    double load_start = omp_get_wtime();
+    int num_points;
+    if (is_points_file(csv_file_name)) {
+        // binary points file from kmeans_convert
+        num_points = read_points_file(csv_file_name, dataset, kmeans_config->max_points, headers, &dimensions);
+    }
+    else if (kmeans_config->stdio_csv) {
+        num_points = read_csv_file(csv_file_name, dataset, kmeans_config->max_points, headers, &dimensions);
+    }
+    else {
+        num_points = mmap_read_csv_file(csv_file_name, dataset, kmeans_config->max_points, headers, &dimensions);
+    }
+    load_seconds = omp_get_wtime() - load_start;
     DEBUG("Loaded %d points from the dataset file at %s", num_points, csv_file_name);
     return num_points;
 }
 
+/**
+ * Open the dataset file and read its headers, for engines that read the points in chunks
+ * with read_csv_points rather than loading them all with load_dataset
+ *
+ * @return the open file positioned at the first point: the caller closes it
+ */
+FILE *open_dataset_stream(int *p_dimensions)
+{
+    char *csv_file_name = valid_file('f', kmeans_config->in_file);
+    if (is_points_file(csv_file_name)) {
+        FAIL("The input %s is a binary points file: streaming reads csv files", csv_file_name);
+    }
+    FILE *csv_file = fopen(csv_file_name, "r");
+    if (!csv_file) {
+        FAIL("Cannot read the input file at %s", csv_file_name);
+    }
+    dimensions = csvheaders(csv_file, headers);
+    *p_dimensions = dimensions;
+    return csv_file;
+}
+
+/**
+ * Write the headers of the dataset file, with a cluster header, at the top of an output file
+ */
+void write_dataset_headers(FILE *out)
+{
+    print_headers(out, headers, dimensions);
+}
+
+/**
+ * Keep the headers and load time of a dataset that the engine loaded itself rather than
+ * with load_dataset, for the output file and the metrics
+ */
+void set_dataset_headers(char *new_headers[], int new_dimensions, double new_load_seconds)
+{
+    for (int i = 0; i < new_dimensions && i < 3; ++i) {
+        headers[i] = new_headers[i];
+    }
+    dimensions = new_dimensions;
+    load_seconds = new_load_seconds;
+}
+
 void main_loop(int max_iterations, struct kmeans_timing *timing)
 {
     // we deliberately skip the centroid initialization phase in calculating the
@@ -53,19 +110,21 @@ void main_loop(int max_iterations, struct kmeans_timing *timing)
 
 void main_finalize(struct pointset *dataset, struct kmeans_metrics *metrics, struct kmeans_timing *timing)
 {
-    // update timings on metrics
-    metrics->assignment_seconds = timing->accumulated_assignment_seconds;
-    metrics->centroids_seconds = timing->accumulated_centroids_seconds;
-    metrics->max_iteration_seconds = timing->max_iteration_seconds;
-    metrics->total_seconds = timing->elapsed_total_seconds;
-    metrics->used_iterations = timing->used_iterations;
-
     // output file is not always written: sometimes we only run for metrics and compare with test data
     if (kmeans_config->out_file) {
         INFO("Writing output to %s\n", kmeans_config->out_file);
         write_csv_file(kmeans_config->out_file, dataset, headers, dimensions);
     }
+    main_test_report(dataset, metrics, timing);
+}
 
+/**
+ * Compare the clustered points with the test file, list them when verbose and report the
+ * metrics: the part of main_finalize after the output, for engines that write the output
+ * file themselves
+ */
+void main_test_report(struct pointset *dataset, struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
     if (IS_DEBUG) {
         write_csv(stdout, dataset, headers, dimensions);
     }
@@ -76,16 +135,33 @@ void main_finalize(struct pointset *dataset, struct kmeans_metrics *metrics, str
         metrics->test_result = test_results(test_file_name, dataset);
     }
 
+    if (IS_VERBOSE) {
+        print_points(stdout, dataset, "Final ");
+    }
+
+    main_report(metrics, timing);
+}
+
+/**
+ * Copy the timings to the metrics and report them: the part of main_finalize that does not
+ * need the dataset, for engines that write the output and test the results themselves
+ */
+void main_report(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    // update timings on metrics
+    metrics->assignment_seconds = timing->accumulated_assignment_seconds;
+    metrics->centroids_seconds = timing->accumulated_centroids_seconds;
+    metrics->max_iteration_seconds = timing->max_iteration_seconds;
+    metrics->total_seconds = timing->elapsed_total_seconds;
+    metrics->used_iterations = timing->used_iterations;
+    metrics->load_seconds = load_seconds;
+
     if (kmeans_config->metrics_file) {
         // metrics file may or may not already exist
         INFO("Reporting metrics to: %s\n", kmeans_config->metrics_file);
         write_metrics_file(kmeans_config->metrics_file, metrics);
     }
 
-    if (IS_VERBOSE) {
-        print_points(stdout, dataset, "Final ");
-    }
-
     if (IS_INFO) {
         summarize_metrics(stdout, metrics);
         printf("\n");
@@ -101,6 +177,7 @@ int main(int argc, char* argv [])
 {
     kmeans_config = new_kmeans_config();
     parse_kmeans_cli(argc, argv, kmeans_config, &log_level);
+    check_engine_options(kmeans_config, engine_options);
 
     // set up a metrics struct to hold timing and other info for comparison
     struct kmeans_metrics *metrics = new_kmeans_metrics(kmeans_config);
@@ -109,7 +186,9 @@ int main(int argc, char* argv [])
     initialize(kmeans_config->max_points, metrics);
 
     // K-Means Lloyds alorithm  Step 1: initialize the centroids
+    double init_start = omp_get_wtime();
     initialize_representatives(kmeans_config->num_clusters);
+    metrics->init_seconds = omp_get_wtime() - init_start;
 
     // run the main loop
     struct kmeans_timing *timing = new_kmeans_timing();
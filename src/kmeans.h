@@ -10,6 +10,16 @@
 #define NUM_CLUSTERS 15
 #define MAX_ITERATIONS 10000
 #define MAX_POINTS 5000
+#define DEFAULT_SEED 42
+#define DEFAULT_BATCH_SIZE 1024
+#define DEFAULT_CHUNK_SIZE 65536
+
+// how the initial centroids are chosen
+enum init_method_t {
+    init_first,  // the first K points of the dataset
+    init_kmeanspp, // k-means++ seeding with a fixed seed
+    init_kmeans_parallel // k-means|| seeding over the nodes (MPI), k-means++ elsewhere
+};
 
 struct point {
     double x, y;
@@ -31,14 +41,38 @@ struct kmeans_config {
     int num_clusters;
     int max_iterations;
     int num_processors;
+    int num_threads; // OpenMP threads per process for the threaded engines (0 = OpenMP default)
+    enum init_method_t init_method; // how the initial centroids are chosen
+    unsigned int seed;              // seed for the random choices of the initialization
+    int batch_size;                 // points sampled per iteration by the mini-batch engine
+    int chunk_size;                 // points read at a time by the streaming engine
     char *in_file;
     char *out_file;
     char *test_file;
     char *metrics_file;
     char *label;
     bool proper_distance; // true means perform square root in euclidean
+    bool fused_reduction; // true means reduce change counts with the centroid sums in one collective (mpi2/hybrid)
+    bool packed_transfer; // true means scatter/gather points packed as struct point in one collective (MPI)
+    bool single_pass;     // true means accumulate centroid sums during assignment in one pass over the data
+    bool simd;            // true means assign clusters with the vectorized kernels
+    bool grid;            // true means assign clusters using a grid index over the centroids
+    bool incremental;     // true means keep the cluster sums between iterations and only move the changed points
+    bool stdio_csv;       // true means load the input with the original getc/strtod csv reader
+    bool mpi_io;          // true means every node reads its own part of the input with MPI-IO (mpi2/hybrid)
 };
 
+// options that only some engines support: each engine lists those it does in engine_options
+// and check_engine_options refuses the others rather than letting the engine ignore them
+#define ENGINE_SINGLE_PASS     (1 << 0)
+#define ENGINE_SIMD            (1 << 1)
+#define ENGINE_GRID            (1 << 2)
+#define ENGINE_INCREMENTAL     (1 << 3)
+#define ENGINE_PACKED_TRANSFER (1 << 4)
+#define ENGINE_FUSED_REDUCTION (1 << 5)
+#define ENGINE_MPI_IO          (1 << 6)
+#define ENGINE_NO_OPTIONS      0
+
 struct kmeans_metrics {
     char *label; // label for metrics row from -l command line arg
     double assignment_seconds;    // total time spent assigning points to clusters in every iteration
@@ -51,6 +85,11 @@ struct kmeans_metrics {
     int num_clusters;    // number of clusters from  -k command line arg
     int max_iterations;  // max iterations from -i command line arg
     int num_processors; // number of processors that mpi is running on
+    int num_threads;    // number of OpenMP threads used by each process
+    const char *init_method; // name of the centroid initialization method from --init
+    double init_seconds;     // time taken to initialize the centroids (not included in total_seconds)
+    double inertia;          // sum of the squared distances from each point to its centroid at the end
+    double load_seconds;     // time taken to load the dataset (not included in total_seconds)
 };
 
 struct kmeans_timing {
@@ -73,5 +112,10 @@ struct kmeans_timing {
 extern int load_dataset(struct pointset *dataset);
 extern void main_loop(int max_iterations, struct kmeans_timing *timing);
 extern void main_finalize(struct pointset *dataset, struct kmeans_metrics *metrics, struct kmeans_timing *timing);
+extern void main_test_report(struct pointset *dataset, struct kmeans_metrics *metrics, struct kmeans_timing *timing);
+extern void main_report(struct kmeans_metrics *metrics, struct kmeans_timing *timing);
+extern FILE *open_dataset_stream(int *p_dimensions);
+extern void write_dataset_headers(FILE *out);
+extern void set_dataset_headers(char *new_headers[], int new_dimensions, double new_load_seconds);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,176 @@
+/**
+ * Binary points files: the arrays of a struct pointset written as they are in memory after a
+ * small header (see kmeans_binary.h), so loading a dataset is a few reads with no parsing.
+ *
+ * Files are made from the csv files by kmeans_convert and are recognised by load_dataset()
+ * from their magic bytes, whatever their name. The column names of the csv are kept in the
+ * header so that the output files look the same as with the csv input.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_binary.h"
+#include "log.h"
+
+/**
+ * Read size bytes at offset in the file into buffer, failing on a short file
+ */
+static void read_fully(int fd, char *file_name, void *buffer, size_t size, off_t offset)
+{
+    char *p = (char *)buffer;
+    while (size > 0) {
+        ssize_t bytes = pread(fd, p, size, offset);
+        if (bytes <= 0) {
+            FAIL("Cannot read %zu bytes at %lld from the points file %s", size, (long long)offset, file_name);
+        }
+        p += bytes;
+        size -= (size_t)bytes;
+        offset += bytes;
+    }
+}
+
+/**
+ * Does the file start with the magic bytes of a binary points file?
+ */
+bool is_points_file(char *file_name)
+{
+    char magic[POINTS_FILE_MAGIC_LENGTH];
+    FILE *file = fopen(file_name, "rb");
+    if (!file) {
+        return false;
+    }
+    bool matches = fread(magic, 1, POINTS_FILE_MAGIC_LENGTH, file) == POINTS_FILE_MAGIC_LENGTH &&
+                   memcmp(magic, POINTS_FILE_MAGIC, POINTS_FILE_MAGIC_LENGTH) == 0;
+    fclose(file);
+    return matches;
+}
+
+/**
+ * Check that the header is one this program can read, failing otherwise
+ *
+ * @param header header read from the start of the points file
+ * @param file_name path to the points file, for the error messages
+ * @param headers if not null, pre-allocated string array to hold the column names
+ *
+ * @return number of columns: 3 with cluster ids, otherwise 2
+ */
+int check_points_file_header(struct points_file_header *header, char *file_name, char *headers[])
+{
+    if (memcmp(header->magic, POINTS_FILE_MAGIC, POINTS_FILE_MAGIC_LENGTH) != 0) {
+        FAIL("%s is not a binary points file", file_name);
+    }
+    if (header->version != POINTS_FILE_VERSION) {
+        FAIL("Unsupported points file version %u in %s (written on a machine with another byte order?)",
+             header->version, file_name);
+    }
+    if (header->dimensions != 2 || header->dtype != POINTS_DTYPE_FLOAT64) {
+        FAIL("Unsupported points file %s: %u dimensions of type %u", file_name, header->dimensions, header->dtype);
+    }
+
+    int dimensions = header->has_clusters ? 3 : 2;
+    if (headers != NULL) {
+        for (int i = 0; i < dimensions; ++i) {
+            headers[i] = (char *)malloc(POINTS_FILE_NAME_LENGTH + 1);
+            memcpy(headers[i], header->column_names[i], POINTS_FILE_NAME_LENGTH);
+            headers[i][POINTS_FILE_NAME_LENGTH] = '\0';
+        }
+    }
+    return dimensions;
+}
+
+/**
+ * Read the points of a binary points file straight into the arrays of the dataset
+ *
+ * @param file_name path to the points file
+ * @param dataset pre-allocated dataset into which to read the file
+ * @param max_points max number of points to read
+ * @param headers if not null, pre-allocated string array to hold the column names
+ * @param dimensions number of columns: 3 with cluster ids, otherwise 2
+ *
+ * @return number of actual points read from the file
+ */
+int read_points_file(char *file_name, struct pointset *dataset, int max_points, char *headers[], int *dimensions)
+{
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot read the input file at %s\n", file_name);
+        exit(1);
+    }
+    struct points_file_header header;
+    read_fully(fd, file_name, &header, sizeof(header), 0);
+    *dimensions = check_points_file_header(&header, file_name, headers);
+
+    int count = header.num_points < (uint64_t)max_points ? (int)header.num_points : max_points;
+    if (count > dataset->num_points) {
+        count = dataset->num_points; // never more than the pre-allocated size
+    }
+    off_t x_offset = sizeof(header);
+    off_t y_offset = x_offset + (off_t)(header.num_points * sizeof(double));
+    off_t clusters_offset = y_offset + (off_t)(header.num_points * sizeof(double));
+    read_fully(fd, file_name, dataset->x_coords, count * sizeof(double), x_offset);
+    read_fully(fd, file_name, dataset->y_coords, count * sizeof(double), y_offset);
+    if (header.has_clusters && sizeof(int) == sizeof(int32_t)) {
+        read_fully(fd, file_name, dataset->cluster_ids, count * sizeof(int32_t), clusters_offset);
+    }
+    else if (header.has_clusters) {
+        for (int n = 0; n < count; ++n) {
+            int32_t cluster;
+            read_fully(fd, file_name, &cluster, sizeof(cluster), clusters_offset + n * sizeof(cluster));
+            dataset->cluster_ids[n] = cluster;
+        }
+    }
+    else {
+        for (int n = 0; n < count; ++n) {
+            dataset->cluster_ids[n] = NO_CLUSTER_ID;
+        }
+    }
+    close(fd);
+
+    dataset->num_points = count;
+    return count;
+}
+
+/**
+ * Write the dataset to a binary points file, overwriting any existing file
+ *
+ * @param file_name path to the points file
+ * @param dataset points to write
+ * @param headers column names to keep in the header (may be null)
+ * @param dimensions number of column names
+ * @param has_clusters true to write the cluster ids of the points
+ */
+void write_points_file(char *file_name, struct pointset *dataset, char *headers[], int dimensions, bool has_clusters)
+{
+    FILE *file = fopen(file_name, "wb");
+    if (!file) {
+        FAIL("Cannot write to the points file at %s", file_name);
+    }
+    struct points_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, POINTS_FILE_MAGIC, POINTS_FILE_MAGIC_LENGTH);
+    header.version = POINTS_FILE_VERSION;
+    header.dimensions = 2;
+    header.num_points = (uint64_t)dataset->num_points;
+    header.dtype = POINTS_DTYPE_FLOAT64;
+    header.has_clusters = has_clusters ? 1 : 0;
+    for (int i = 0; headers != NULL && i < dimensions && i < 3; ++i) {
+        strncpy(header.column_names[i], headers[i], POINTS_FILE_NAME_LENGTH - 1);
+    }
+
+    size_t num_points = (size_t)dataset->num_points;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(dataset->x_coords, sizeof(double), num_points, file) == num_points &&
+                   fwrite(dataset->y_coords, sizeof(double), num_points, file) == num_points;
+    for (size_t n = 0; written && has_clusters && n < num_points; ++n) {
+        int32_t cluster = dataset->cluster_ids[n];
+        written = fwrite(&cluster, sizeof(cluster), 1, file) == 1;
+    }
+    if (fclose(file) != 0 || !written) {
+        FAIL("Failed to write %zu points to the points file at %s", num_points, file_name);
+    }
+}
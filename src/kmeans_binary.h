@@ -0,0 +1,38 @@
+#ifndef KMEANS_BINARY_H
+#define KMEANS_BINARY_H
+
+#include <stdint.h>
+#include "kmeans.h"
+
+// first bytes of a binary points file
+#define POINTS_FILE_MAGIC "KMPOINTS"
+#define POINTS_FILE_MAGIC_LENGTH 8
+#define POINTS_FILE_VERSION 1
+// the only coordinate type so far: IEEE 754 double
+#define POINTS_DTYPE_FLOAT64 1
+// room for each column name so that the output csv keeps the headers of the input
+#define POINTS_FILE_NAME_LENGTH 32
+
+/**
+ * Header at the start of a binary points file, in the byte order of the machine that wrote it.
+ * It is followed by num_points x coordinates, then num_points y coordinates, then num_points
+ * 32-bit cluster ids when has_clusters is set: the arrays of struct pointset.
+ */
+struct points_file_header {
+    char magic[POINTS_FILE_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t dimensions;   // always 2: x and y
+    uint64_t num_points;
+    uint32_t dtype;        // POINTS_DTYPE_FLOAT64
+    uint32_t has_clusters; // 1 if the cluster ids follow the coordinates
+    char column_names[3][POINTS_FILE_NAME_LENGTH]; // x, y and cluster headers of the csv
+};
+
+extern bool is_points_file(char *file_name);
+extern int check_points_file_header(struct points_file_header *header, char *file_name, char *headers[]);
+extern int read_points_file(char *file_name, struct pointset *dataset, int max_points, char *headers[],
+                            int *dimensions);
+extern void write_points_file(char *file_name, struct pointset *dataset, char *headers[], int dimensions,
+                              bool has_clusters);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef KMEANS_BOUNDS_H
+#define KMEANS_BOUNDS_H
+
+/**
+ * Helpers shared by the engines that skip distance calculations using triangle inequality
+ * bounds (Elkan, Hamerly, Yinyang) or by filtering centroids over boxes (kd-tree, grid).
+ *
+ * Bounds are true euclidean distances, but candidates are compared on the same squared
+ * distances as simple_assign_clusters with ties going to the lowest cluster index, so these
+ * engines give exactly the same clustering. Upper bounds are widened and lower bounds narrowed
+ * by BOUND_SLACK so that rounding can never prune a candidate that ties with the assigned one.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include "kmeans.h"
+
+// relative margin added to the upper bounds and taken off the lower bounds to cover rounding
+#define BOUND_SLACK 1e-9
+
+/**
+ * The squared distance, exactly as calculated by euclidean_distance for simple_assign_clusters
+ */
+static inline double squared_point_distance(struct pointset *dataset, int n, struct pointset *centroids, int k)
+{
+    double diff_x = centroids->x_coords[k] - dataset->x_coords[n];
+    double diff_y = centroids->y_coords[k] - dataset->y_coords[n];
+    return diff_x * diff_x + diff_y * diff_y;
+}
+
+/**
+ * Squared distance from any x, y location to centroid k
+ */
+static inline double squared_centroid_distance(struct pointset *centroids, int k, double x, double y)
+{
+    double diff_x = centroids->x_coords[k] - x;
+    double diff_y = centroids->y_coords[k] - y;
+    return diff_x * diff_x + diff_y * diff_y;
+}
+
+/**
+ * Is the squared distance to candidate k closer than the best so far, with the same
+ * tie-break on the lowest cluster index as simple_assign_clusters?
+ */
+static inline bool closer_cluster(double distance, int k, double best_distance, int best_cluster)
+{
+    return distance < best_distance || (distance == best_distance && k < best_cluster);
+}
+
+static inline double upper_bound(double squared_distance)
+{
+    return sqrt(squared_distance) * (1 + BOUND_SLACK);
+}
+
+static inline double lower_bound(double squared_distance)
+{
+    return sqrt(squared_distance) * (1 - BOUND_SLACK);
+}
+
+/**
+ * Lower bound minus the distance a centroid moved, never below zero
+ */
+static inline double move_lower_bound(double bound, double drift)
+{
+    double moved = bound - drift;
+    return moved > 0.0 ? moved : 0.0;
+}
+
+/**
+ * Upper bound on how far each centroid moved in the last centroid calculation
+ */
+static inline void centroid_drift(struct pointset *old_centroids, struct pointset *centroids, double *drift)
+{
+    for (int k = 0; k < centroids->num_points; ++k) {
+        double diff_x = centroids->x_coords[k] - old_centroids->x_coords[k];
+        double diff_y = centroids->y_coords[k] - old_centroids->y_coords[k];
+        drift[k] = upper_bound(diff_x * diff_x + diff_y * diff_y);
+    }
+}
+
+/**
+ * Lower bound on half the distance from each centroid to its closest other centroid:
+ * a point within that distance of its centroid cannot be closer to any other one.
+ */
+static inline void centroid_half_separation(struct pointset *centroids, double *half_separation)
+{
+    int num_clusters = centroids->num_points;
+    for (int k = 0; k < num_clusters; ++k) {
+        half_separation[k] = INFINITY;
+    }
+    for (int k = 0; k < num_clusters; ++k) {
+        for (int j = k + 1; j < num_clusters; ++j) {
+            double diff_x = centroids->x_coords[k] - centroids->x_coords[j];
+            double diff_y = centroids->y_coords[k] - centroids->y_coords[j];
+            double half_distance = 0.5 * lower_bound(diff_x * diff_x + diff_y * diff_y);
+            if (half_distance < half_separation[k]) half_separation[k] = half_distance;
+            if (half_distance < half_separation[j]) half_separation[j] = half_distance;
+        }
+    }
+}
+
+/**
+ * Is centroid z further than the closest centroid from every point in the box?
+ * The corner of the box furthest in the direction from the closest towards z is the point
+ * of the box most in favour of z, so only that corner needs to be checked. The bounds slack
+ * keeps candidates that could tie with the closest one.
+ */
+static inline bool further_from_box(struct pointset *centroids, int z, int closest,
+                                    double min_x, double max_x, double min_y, double max_y)
+{
+    double corner_x = centroids->x_coords[z] > centroids->x_coords[closest] ? max_x : min_x;
+    double corner_y = centroids->y_coords[z] > centroids->y_coords[closest] ? max_y : min_y;
+    return lower_bound(squared_centroid_distance(centroids, z, corner_x, corner_y)) >
+           upper_bound(squared_centroid_distance(centroids, closest, corner_x, corner_y));
+}
+
+#endif
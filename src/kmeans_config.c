@@ -4,9 +4,18 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
 #include "log.h"
 
+// engines named in the errors and usage for the options that only some engines support
+#define KERNEL_ENGINES "kmeans_simple, kmeans_mpi2 and kmeans_hybrid"
+#define MPI_ENGINES "kmeans_mpi1, kmeans_mpi2 and kmeans_hybrid"
+#define MPI2_ENGINES "kmeans_mpi2 and kmeans_hybrid"
+
 extern struct kmeans_config *kmeans_config;
 
 /**
@@ -25,6 +34,20 @@ struct kmeans_config *new_kmeans_config()
     new_config->num_clusters = NUM_CLUSTERS;
     new_config->max_iterations = MAX_ITERATIONS;
     new_config->num_processors = 1;
+    new_config->num_threads = 0;
+    new_config->init_method = init_first;
+    new_config->seed = DEFAULT_SEED;
+    new_config->batch_size = DEFAULT_BATCH_SIZE;
+    new_config->chunk_size = DEFAULT_CHUNK_SIZE;
+    new_config->proper_distance = false;
+    new_config->fused_reduction = false;
+    new_config->packed_transfer = false;
+    new_config->single_pass = false;
+    new_config->simd = false;
+    new_config->grid = false;
+    new_config->incremental = false;
+    new_config->stdio_csv = false;
+    new_config->mpi_io = false;
     return new_config;
 }
 
@@ -37,6 +60,12 @@ struct kmeans_metrics *new_kmeans_metrics(struct kmeans_config *config)
     new_metrics->label = config->label;
     new_metrics->max_iterations = config->max_iterations;
     new_metrics->num_clusters = config->num_clusters;
+    new_metrics->num_processors = 1;
+    new_metrics->num_threads = 1;
+    new_metrics->init_method = init_method_name(config->init_method);
+    new_metrics->init_seconds = 0;
+    new_metrics->inertia = 0;
+    new_metrics->load_seconds = 0;
     new_metrics->total_seconds = 0;
     new_metrics->test_result = 0; // zero = no test performed
     return new_metrics;
@@ -80,14 +109,33 @@ void kmeans_usage()
 {
     fprintf(stderr, "Usage: kmeans_<program> [options]\n");
     fprintf(stderr, "Options include:\n");
-    fprintf(stderr, "    -f INFILE.CSV to read data points from a file (REQUIRED)\n");
+    fprintf(stderr, "    -f INFILE.CSV to read data points from a file (REQUIRED): csv or a binary points file from kmeans_convert\n");
     fprintf(stderr, "    -k --clusters NUM number of clusters to create (default: %d)\n", NUM_CLUSTERS);
     fprintf(stderr, "    -n --max-points NUM maximum number of points to read from the input file (default: %d)\n", MAX_POINTS);
     fprintf(stderr, "    -i --iterations NUM maximum number of iterations to loop over (default: %d)\n", MAX_ITERATIONS);
     fprintf(stderr, "    -o OUTFILE.CSV to write the resulting clustered points to a file (default is none)\n");
     fprintf(stderr, "    -t TEST.CSV compare result with TEST.CSV\n");
     fprintf(stderr, "    -m METRICS.CSV append metrics to this CSV file (creates it if it does not exist)\n");
+    fprintf(stderr, "    --threads NUM number of OpenMP threads per process for threaded engines (default: OMP_NUM_THREADS)\n");
+    fprintf(stderr, "    --init METHOD initial centroids: first (the first K points, default), kmeans++\n"
+                    "        or kmeans|| (k-means|| over the MPI nodes with kmeans_mpi2, the same as kmeans++ elsewhere)\n");
+    fprintf(stderr, "    --seed NUM seed for the random choices of --init kmeans++ and kmeans|| (default: %d)\n", DEFAULT_SEED);
+    fprintf(stderr, "    --batch-size NUM points sampled per iteration by kmeans_minibatch (default: %d)\n", DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "    --chunk-size NUM points read from the input at a time by kmeans_stream (default: %d)\n", DEFAULT_CHUNK_SIZE);
+    fprintf(stderr, "    --stdio-csv load the input with the original csv reader instead of the memory mapped one\n");
+    fprintf(stderr, "    --mpi-io every node reads its own part of the input with MPI-IO instead of a scatter from root\n"
+                    "        (kmeans_mpi2/kmeans_hybrid only, with --init first or kmeans||)\n");
     fprintf(stderr, "    -e --proper-distance measure Euclidean proper distance (slow) (defaults to faster square of distance)\n");
+    fprintf(stderr, "    The assignment kernel options choose one kernel each (" KERNEL_ENGINES " only):\n");
+    fprintf(stderr, "    --simd assign clusters with vectorized kernels for the widest instruction set available\n");
+    fprintf(stderr, "    --grid assign clusters searching outward from each point through a grid index over the centroids\n");
+    fprintf(stderr, "    --single-pass accumulate the centroid sums while assigning points in one pass over the data\n");
+    fprintf(stderr, "    --incremental update the cluster sums by moving only the points that change cluster (full recompute every %d iterations)\n",
+            INCREMENTAL_REFRESH_ITERATIONS);
+    fprintf(stderr, "    --fused-reduction reduce the change count with the centroid sums: one collective per iteration\n"
+                    "        (kmeans_mpi2/kmeans_hybrid only)\n");
+    fprintf(stderr, "    --packed-transfer scatter and gather points packed in a single message instead of one per array\n"
+                    "        (" MPI_ENGINES " only)\n");
     fprintf(stderr, "    --info for info level messages\n");
     fprintf(stderr, "    --verbose for extra detail messages\n");
     fprintf(stderr, "    --warn to suppress all but warning and error messages\n");
@@ -118,6 +166,48 @@ int valid_count(char opt, char *arg)
     return value;
 }
 
+/**
+ * Parse the value of --seed: any unsigned int, including 0
+ */
+unsigned int valid_seed(char *arg)
+{
+    char *end;
+    errno = 0;
+    unsigned long value = strtoul(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || strchr(arg, '-') != NULL || errno != 0 || value > UINT_MAX) {
+        fprintf(stderr, "Error: The option --seed expects an unsigned number up to %u (got %s)\n", UINT_MAX, arg);
+        kmeans_usage();
+    }
+    return (unsigned int)value;
+}
+
+const char *init_method_name(enum init_method_t init_method)
+{
+    switch (init_method) {
+        case init_kmeanspp:
+            return "kmeans++";
+        case init_kmeans_parallel:
+            return "kmeans||";
+        default:
+            return "first";
+    }
+}
+
+enum init_method_t valid_init_method(char *arg)
+{
+    if (strcmp(arg, "kmeans++") == 0) {
+        return init_kmeanspp;
+    }
+    if (strcmp(arg, "kmeans||") == 0) {
+        return init_kmeans_parallel;
+    }
+    if (strcmp(arg, "first") != 0) {
+        fprintf(stderr, "Error: Unknown initialization method '%s'\n", arg);
+        kmeans_usage();
+    }
+    return init_first;
+}
+
 void validate_config(struct kmeans_config *config)
 {
     if (config->in_file == NULL || strlen(config->in_file) == 0) {
@@ -125,6 +215,20 @@ void validate_config(struct kmeans_config *config)
         kmeans_usage();
     }
 
+    // each of these chooses its own assignment kernel: there is no kernel that combines them
+    int kernels = (config->simd ? 1 : 0) + (config->grid ? 1 : 0) + (config->single_pass || config->incremental ? 1 : 0);
+    if (kernels > 1) {
+        fprintf(stderr, "ERROR: --simd, --grid and --single-pass or --incremental each choose a different "
+                        "assignment kernel: use only one of them\n");
+        kmeans_usage();
+    }
+
+    if (config->mpi_io && config->init_method == init_kmeanspp) {
+        fprintf(stderr, "ERROR: --init kmeans++ needs every point on the root, which --mpi-io avoids: "
+                        "use --init kmeans|| to choose the centroids over the nodes\n");
+        kmeans_usage();
+    }
+
     const char* distance_type = config->proper_distance ? "proper distance" : "relative distance (d^2)";
     const char* loop_order_names[] = {"ijk", "ikj", "jki"};
     if (IS_DEBUG) {
@@ -136,11 +240,55 @@ void validate_config(struct kmeans_config *config)
         printf("Clusters (k)      : %-10d\n", config->num_clusters);
         printf("Max Iterations    : %-10d\n", config->max_iterations);
         printf("Max Points        : %-10d\n", config->max_points);
+        printf("Threads           : %-10d\n", config->num_threads);
         printf("Distance measure  : %s\n", distance_type);
+        printf("Initialization    : %s (seed %u)\n", init_method_name(config->init_method), config->seed);
+        printf("Batch size        : %-10d\n", config->batch_size);
+        printf("Chunk size        : %-10d\n", config->chunk_size);
+        printf("CSV reader        : %s\n", config->stdio_csv ? "stdio" : "mmap");
+        printf("MPI-IO input      : %s\n", config->mpi_io ? "yes" : "no");
+        printf("SIMD assignment   : %s\n", config->simd ? "yes" : "no");
+        printf("Grid assignment   : %s\n", config->grid ? "yes" : "no");
+        printf("Single pass       : %s\n", config->single_pass ? "yes" : "no");
+        printf("Incremental       : %s\n", config->incremental ? "yes" : "no");
+        printf("Fused reduction   : %s\n", config->fused_reduction ? "yes" : "no");
+        printf("Packed transfer   : %s\n", config->packed_transfer ? "yes" : "no");
         printf("\n");
     }
 }
 
+/**
+ * Refuse the options that the engine does not support, which it would otherwise silently
+ * ignore while the metrics row looks like a run with the option
+ *
+ * @param config parsed config
+ * @param supported the ENGINE_ options that the engine supports (engine_options)
+ */
+void check_engine_options(struct kmeans_config *config, int supported)
+{
+    struct {
+        int option;
+        bool requested;
+        const char *name;
+        const char *engines;
+    } options[] = {
+            {ENGINE_SINGLE_PASS,     config->single_pass,     "--single-pass",     KERNEL_ENGINES},
+            {ENGINE_SIMD,            config->simd,            "--simd",            KERNEL_ENGINES},
+            {ENGINE_GRID,            config->grid,            "--grid",            KERNEL_ENGINES},
+            {ENGINE_INCREMENTAL,     config->incremental,     "--incremental",     KERNEL_ENGINES},
+            {ENGINE_PACKED_TRANSFER, config->packed_transfer, "--packed-transfer", MPI_ENGINES},
+            {ENGINE_FUSED_REDUCTION, config->fused_reduction, "--fused-reduction", MPI2_ENGINES},
+            {ENGINE_MPI_IO,          config->mpi_io,          "--mpi-io",          MPI2_ENGINES},
+    };
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); ++i) {
+        if (options[i].requested && (supported & options[i].option) == 0) {
+            fprintf(stderr, "ERROR: %s is not supported by this program: only by %s\n",
+                    options[i].name, options[i].engines);
+            kmeans_usage();
+        }
+    }
+}
+
 /**
  * Parse command line args and construct a config object
  */
@@ -158,6 +306,19 @@ void parse_kmeans_cli(int argc, char *argv[], struct kmeans_config *new_config,
             {"max-points", required_argument, NULL,        'n'},
             {"proper-distance", required_argument, NULL,   'e'},
             {"help", required_argument, NULL,              'h'},
+            {"fused-reduction", no_argument, NULL,         'R'},
+            {"packed-transfer", no_argument, NULL,         'P'},
+            {"threads", required_argument, NULL,           'T'},
+            {"single-pass", no_argument, NULL,             'S'},
+            {"simd", no_argument, NULL,                    'V'},
+            {"grid", no_argument, NULL,                    'G'},
+            {"init", required_argument, NULL,              'N'},
+            {"seed", required_argument, NULL,              'D'},
+            {"incremental", no_argument, NULL,             'I'},
+            {"batch-size", required_argument, NULL,        'B'},
+            {"chunk-size", required_argument, NULL,        'C'},
+            {"stdio-csv", no_argument, NULL,               'L'},
+            {"mpi-io", no_argument, NULL,                  'M'},
             // log options
             {"error", no_argument, (int *)new_log_level,   error},
             {"warn", no_argument, (int *)new_log_level,    warn},
@@ -209,6 +370,45 @@ void parse_kmeans_cli(int argc, char *argv[], struct kmeans_config *new_config,
             case 'l':
                 new_config->label = optarg;
                 break;
+            case 'R':
+                new_config->fused_reduction = true;
+                break;
+            case 'P':
+                new_config->packed_transfer = true;
+                break;
+            case 'V':
+                new_config->simd = true;
+                break;
+            case 'N':
+                new_config->init_method = valid_init_method(optarg);
+                break;
+            case 'D':
+                new_config->seed = valid_seed(optarg);
+                break;
+            case 'G':
+                new_config->grid = true;
+                break;
+            case 'I':
+                new_config->incremental = true;
+                break;
+            case 'B':
+                new_config->batch_size = valid_count('B', optarg);
+                break;
+            case 'C':
+                new_config->chunk_size = valid_count('C', optarg);
+                break;
+            case 'L':
+                new_config->stdio_csv = true;
+                break;
+            case 'M':
+                new_config->mpi_io = true;
+                break;
+            case 'S':
+                new_config->single_pass = true;
+                break;
+            case 'T':
+                new_config->num_threads = valid_count('T', optarg);
+                break;
             case ':':
                 fprintf(stderr, "ERROR: Option %c needs a value\n", optopt);
                 kmeans_usage();
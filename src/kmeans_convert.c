@@ -0,0 +1,104 @@
+/**
+ * Convert a csv dataset to a binary points file, which the kmeans programs load without
+ * parsing, or a binary points file back to csv.
+ *
+ * Usage: kmeans_convert [-n MAX_POINTS] [--no-clusters] INFILE OUTFILE
+ *
+ * The direction is chosen from the input: a binary points file is written out as csv in the
+ * format of the kmeans output files, anything else is read as csv and written as a binary
+ * points file. The cluster column of a clustered csv (such as the KNIME test files) is kept
+ * in the binary file unless --no-clusters is given.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_csv.h"
+#include "kmeans_binary.h"
+#include "log.h"
+
+struct kmeans_config *kmeans_config;
+enum log_level_t log_level = warn;
+
+static void convert_usage()
+{
+    fprintf(stderr, "Usage: kmeans_convert [options] INFILE OUTFILE\n");
+    fprintf(stderr, "Converts a csv dataset to a binary points file, or a binary points file back to csv\n");
+    fprintf(stderr, "Options include:\n");
+    fprintf(stderr, "    -n --max-points NUM maximum number of points to convert (default: all)\n");
+    fprintf(stderr, "    --no-clusters leave out the cluster column of a clustered csv (csv to binary only)\n");
+    fprintf(stderr, "    --info for info level messages\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    kmeans_config = new_kmeans_config();
+    int max_points = 0;
+    bool keep_clusters = true;
+    struct option long_options[] = {
+            {"max-points", required_argument, NULL, 'n'},
+            {"no-clusters", no_argument, NULL,      'c'},
+            {"info", no_argument, NULL,             'v'},
+            {"help", no_argument, NULL,             'h'},
+            {NULL, 0, NULL,                         0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                max_points = valid_count('n', optarg);
+                break;
+            case 'c':
+                keep_clusters = false;
+                break;
+            case 'v':
+                log_level = info;
+                break;
+            default:
+                convert_usage();
+        }
+    }
+    if (argc - optind != 2) {
+        convert_usage();
+    }
+    char *in_file = argv[optind];
+    if (access(in_file, F_OK) != 0) {
+        fprintf(stderr, "ERROR: Cannot find the input file %s\n", in_file);
+        convert_usage();
+    }
+    char *out_file = argv[optind + 1];
+
+    char *headers[3] = {NULL, NULL, NULL};
+    int dimensions = 0;
+    struct pointset dataset;
+    double start = omp_get_wtime();
+    if (is_points_file(in_file)) {
+        struct points_file_header header;
+        FILE *file = fopen(in_file, "rb");
+        if (!file || fread(&header, sizeof(header), 1, file) != 1) {
+            FAIL("Cannot read the header of the points file %s", in_file);
+        }
+        fclose(file);
+        int num_points = (int)header.num_points;
+        if (max_points > 0 && max_points < num_points) num_points = max_points;
+        allocate_pointset_points(&dataset, num_points > 0 ? num_points : 1);
+        read_points_file(in_file, &dataset, num_points, headers, &dimensions);
+        // the csv writer adds the cluster header and column itself
+        write_csv_file(out_file, &dataset, headers, 2);
+    }
+    else {
+        int num_points = count_csv_points(in_file);
+        if (max_points > 0 && max_points < num_points) num_points = max_points;
+        allocate_pointset_points(&dataset, num_points > 0 ? num_points : 1);
+        mmap_read_csv_file(in_file, &dataset, num_points, headers, &dimensions);
+        write_points_file(out_file, &dataset, headers, dimensions, keep_clusters && dimensions > 2);
+    }
+    INFO("Converted %d points from %s to %s in %f seconds", dataset.num_points, in_file, out_file,
+         omp_get_wtime() - start);
+    free(kmeans_config);
+    return 0;
+}
@@ -0,0 +1,430 @@
+/**
+ * Fast loader for the 2-D points CSV files: the same results as read_csv_file() without
+ * the per-character getc, line copies and strtod calls of the csvhelper functions.
+ *
+ * The file is memory mapped and parsed in place. Line ends and field separators are found
+ * 16 bytes at a time with SSE2 on x86 (a byte loop elsewhere), and the coordinates are parsed
+ * straight into x_coords and y_coords with an exact fast path: up to 19 significant digits
+ * are read into an integer and scaled by an exactly representable power of ten, so one
+ * correctly rounded multiplication or division gives the same double as strtod (Clinger's fast
+ * path). Anything outside the fast path (mantissas above 2^53, exponents beyond 22, quotes,
+ * spaces, inf and so on) falls back to strtod on a copy of the field.
+ *
+ * Large files are parsed by all the OpenMP threads, each over its own range of lines (see
+ * parse_csv_lines). Lines end with \n or \r\n. Like read_csv(), reading stops at a line with
+ * fewer than two fields, and the third field is read as the cluster when the headers have more
+ * than two columns, ignoring any prefix before the cluster number (as in "cluster_3").
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_csv.h"
+#include "log.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define KMEANS_CSV_SSE2
+#include <emmintrin.h>
+#endif
+
+// longest field copied for the strtod fallback
+#define MAX_FIELD_LENGTH 64
+// largest integer below which every integer is exactly representable as a double
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+// largest power of ten that is exactly representable as a double
+#define MAX_EXACT_POWER 22
+// smallest part of the file parsed by each thread
+#define CSV_MIN_RANGE_BYTES (1 << 20)
+
+static const double exact_powers_of_ten[MAX_EXACT_POWER + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Find the first c between p and end
+ *
+ * @return pointer to the first c or end if there is none
+ */
+static inline const char *find_char(const char *p, const char *end, char c)
+{
+#ifdef KMEANS_CSV_SSE2
+    __m128i wanted = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, wanted));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * Parse the field from start to end with strtod, on a copy since the mapped file is not
+ * terminated, removing surrounding quotes as the csvhelper split does
+ */
+static double slow_parse_double(const char *start, const char *end)
+{
+    char field[MAX_FIELD_LENGTH + 1];
+    if (end - start >= 2 && *start == '"' && end[-1] == '"') {
+        start++;
+        end--;
+    }
+    size_t length = end - start < MAX_FIELD_LENGTH ? (size_t)(end - start) : MAX_FIELD_LENGTH;
+    memcpy(field, start, length);
+    field[length] = '\0';
+    return strtod(field, NULL);
+}
+
+/**
+ * Parse the whole field from start to end as a double: exactly the value strtod gives
+ */
+static inline double parse_double(const char *start, const char *end)
+{
+    const char *p = start;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+        if (mantissa > 0 || *p != '0') significant_digits++;
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (mantissa > 0 || *p != '0') significant_digits++;
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *exponent_start = p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative_exponent = *p == '-';
+            p++;
+        }
+        int written_exponent = 0;
+        int exponent_digits = 0;
+        for (; p < end && *p >= '0' && *p <= '9' && exponent_digits < 4; ++p, ++exponent_digits) {
+            written_exponent = written_exponent * 10 + (*p - '0');
+        }
+        if (exponent_digits == 0) {
+            p = exponent_start; // not an exponent: let strtod decide what the field is
+        }
+        exponent += negative_exponent ? -written_exponent : written_exponent;
+    }
+
+    // the whole field must be a plain number that fits the exact fast path
+    if (p != end || digits == 0 || significant_digits > 19 || mantissa > MAX_EXACT_MANTISSA ||
+        exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER) {
+        return slow_parse_double(start, end);
+    }
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / exact_powers_of_ten[-exponent] : value * exact_powers_of_ten[exponent];
+    return negative ? -value : value;
+}
+
+/**
+ * Parse the cluster number at the end of a field like "cluster_3"
+ */
+static inline int parse_cluster(const char *p, const char *end)
+{
+    while (p < end && (*p < '0' || *p > '9')) {
+        p++;
+    }
+    if (p == end) {
+        return NO_CLUSTER_ID;
+    }
+    int cluster = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        cluster = cluster * 10 + (*p - '0');
+    }
+    return cluster;
+}
+
+/**
+ * Parse the point on the line from line to line_end (without the line terminator) into
+ * the dataset at index
+ *
+ * @return false if the line has fewer than two fields
+ */
+static inline bool parse_csv_line(const char *line, const char *line_end, struct pointset *dataset, int index,
+                                  bool has_cluster)
+{
+    const char *x_end = find_char(line, line_end, ',');
+    if (x_end == line_end) {
+        return false;
+    }
+    const char *y_start = x_end + 1;
+    const char *y_end = find_char(y_start, line_end, ',');
+    dataset->x_coords[index] = parse_double(line, x_end);
+    dataset->y_coords[index] = parse_double(y_start, y_end);
+    dataset->cluster_ids[index] = NO_CLUSTER_ID;
+    if (has_cluster && y_end < line_end) {
+        const char *cluster_start = y_end + 1;
+        dataset->cluster_ids[index] = parse_cluster(cluster_start, find_char(cluster_start, line_end, ','));
+    }
+    return true;
+}
+
+/**
+ * End of the content of the line starting at line and ending at line_end: before any \r of a \r\n
+ */
+static inline const char *line_content_end(const char *line_end, const char *line)
+{
+    return line_end > line && line_end[-1] == '\r' ? line_end - 1 : line_end;
+}
+
+/**
+ * Copy the header fields of the first line into the headers array (up to 3 as for the points)
+ *
+ * @return the number of headers
+ */
+static int read_headers(const char *line, const char *line_end, char *headers[])
+{
+    int num_headers = 0;
+    const char *p = line;
+    while (true) {
+        const char *field_end = find_char(p, line_end, ',');
+        if (headers != NULL && num_headers < 3) {
+            const char *start = p;
+            const char *end = field_end;
+            if (end - start >= 2 && *start == '"' && end[-1] == '"') {
+                start++;
+                end--;
+            }
+            headers[num_headers] = (char *)malloc(end - start + 1);
+            memcpy(headers[num_headers], start, end - start);
+            headers[num_headers][end - start] = '\0';
+        }
+        num_headers++;
+        if (field_end == line_end) break;
+        p = field_end + 1;
+    }
+    return num_headers;
+}
+
+/**
+ * Count the lines that start between start and stop, where stop is just after a \n or at the
+ * end of the file
+ */
+int count_csv_lines(const char *start, const char *stop)
+{
+    int lines = 0;
+    const char *p = start;
+#ifdef KMEANS_CSV_SSE2
+    __m128i newline = _mm_set1_epi8('\n');
+    for (; stop - p >= 16; p += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+    }
+#endif
+    for (; p < stop; ++p) {
+        if (*p == '\n') lines++;
+    }
+    // the last line of the file may have no \n
+    if (stop > start && stop[-1] != '\n') {
+        lines++;
+    }
+    return lines;
+}
+
+/**
+ * Parse the points of all the lines from body to end into the dataset.
+ *
+ * The bytes are split into one range per OpenMP thread, each moved to start just after a \n,
+ * and the lines of each range are counted. A prefix sum over the counts gives the index of the
+ * first point of each range, so the threads can then parse their ranges in parallel straight
+ * into the dataset. Files smaller than CSV_MIN_RANGE_BYTES per thread use fewer threads.
+ * The text must start at the beginning of a line and end just after a \n or at the end of
+ * the file: the whole body of a file or the part of it read by one MPI node.
+ *
+ * @return the number of points: up to max_points, and only those before the first line with
+ *         fewer than two fields
+ */
+int parse_csv_lines(const char *body, const char *end, struct pointset *dataset, int max_points,
+                    bool has_cluster)
+{
+    size_t body_size = (size_t)(end - body);
+    int num_ranges = omp_get_max_threads();
+    if ((size_t)num_ranges > body_size / CSV_MIN_RANGE_BYTES) {
+        num_ranges = (int)(body_size / CSV_MIN_RANGE_BYTES);
+    }
+    if (num_ranges < 1) {
+        num_ranges = 1;
+    }
+
+    const char *range_start[num_ranges + 1];
+    int range_offset[num_ranges + 1];
+    const char *bad_line[num_ranges]; // first line with fewer than two fields in each range
+    int bad_line_index[num_ranges];
+    range_start[0] = body;
+    range_start[num_ranges] = end;
+    for (int r = 1; r < num_ranges; ++r) {
+        const char *newline = find_char(body + body_size / num_ranges * r, end, '\n');
+        range_start[r] = newline < end ? newline + 1 : end;
+        if (range_start[r] < range_start[r - 1]) {
+            range_start[r] = range_start[r - 1];
+        }
+    }
+
+    int range_lines[num_ranges];
+    #pragma omp parallel for schedule(static, 1) num_threads(num_ranges)
+    for (int r = 0; r < num_ranges; ++r) {
+        range_lines[r] = count_csv_lines(range_start[r], range_start[r + 1]);
+    }
+    range_offset[0] = 0;
+    for (int r = 0; r < num_ranges; ++r) {
+        range_offset[r + 1] = range_offset[r] + range_lines[r];
+    }
+
+    #pragma omp parallel for schedule(static, 1) num_threads(num_ranges)
+    for (int r = 0; r < num_ranges; ++r) {
+        bad_line[r] = NULL;
+        bad_line_index[r] = range_offset[r + 1];
+        const char *line = range_start[r];
+        const char *stop = range_start[r + 1];
+        for (int index = range_offset[r]; index < max_points && line < stop; ++index) {
+            const char *line_end = find_char(line, stop, '\n');
+            if (!parse_csv_line(line, line_content_end(line_end, line), dataset, index, has_cluster)) {
+                bad_line[r] = line;
+                bad_line_index[r] = index;
+                break;
+            }
+            line = line_end + 1;
+        }
+    }
+
+    // points after the first bad line in the file are not counted, as in read_csv()
+    int count = range_offset[num_ranges] < max_points ? range_offset[num_ranges] : max_points;
+    for (int r = 0; r < num_ranges; ++r) {
+        if (bad_line[r] != NULL && bad_line_index[r] < count) {
+            const char *line_end = find_char(bad_line[r], end, '\n');
+            printf("Warning: found non-empty trailing line. Will stop reading points now: %.*s\n",
+                   (int)(line_end - bad_line[r]), bad_line[r]);
+            count = bad_line_index[r];
+            break;
+        }
+    }
+    DEBUG("Parsed %d points from %d ranges", count, num_ranges);
+    return count;
+}
+
+/**
+ * Read the headers from the first line of the csv text from data to end
+ *
+ * @param headers if not null, string array to hold the headers (up to 3)
+ * @param body set to the start of the line after the headers, or end if there is none
+ *
+ * @return the number of headers
+ */
+int parse_csv_headers(const char *data, const char *end, char *headers[], const char **body)
+{
+    const char *line_end = find_char(data, end, '\n');
+    *body = line_end < end ? line_end + 1 : end;
+    return read_headers(data, line_content_end(line_end, data), headers);
+}
+
+/**
+ * Count the lines after the headers of a CSV file: the most points it can have, to size the
+ * dataset before reading a whole file
+ */
+int count_csv_points(char *csv_file_name)
+{
+    int fd = open(csv_file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot read the input file at %s\n", csv_file_name);
+        exit(1);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        FAIL("Cannot find the size of the input file at %s", csv_file_name);
+    }
+    size_t file_size = (size_t)file_stat.st_size;
+    int lines = 0;
+    if (file_size > 0) {
+        const char *data = (const char *)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            FAIL("Cannot map the input file at %s", csv_file_name);
+        }
+        lines = count_csv_lines(data, data + file_size) - 1; // not the headers
+        munmap((void *)data, file_size);
+    }
+    close(fd);
+    return lines > 0 ? lines : 0;
+}
+
+/**
+ * Read 2-dimensional points from the CSV file with headers, with the same results as
+ * read_csv_file() but much faster on large files
+ *
+ * @param csv_file_name path to the input file
+ * @param dataset pre-allocated dataset into which to read the file
+ * @param max_points max number of points to read
+ * @param headers if not null, pre-allocated string array to hold the headers
+ * @param dimensions number of headers
+ *
+ * @return number of actual points read from the file
+ */
+int mmap_read_csv_file(char *csv_file_name, struct pointset *dataset, int max_points, char *headers[], int *dimensions)
+{
+    int fd = open(csv_file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot read the input file at %s\n", csv_file_name);
+        exit(1);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        FAIL("Cannot find the size of the input file at %s", csv_file_name);
+    }
+    size_t file_size = (size_t)file_stat.st_size;
+    *dimensions = 0;
+    if (file_size == 0) {
+        close(fd);
+        dataset->num_points = 0;
+        return 0;
+    }
+    const char *data = (const char *)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        FAIL("Cannot map the input file at %s", csv_file_name);
+    }
+    posix_madvise((void *)data, file_size, POSIX_MADV_SEQUENTIAL);
+    const char *end = data + file_size;
+
+    const char *body;
+    *dimensions = parse_csv_headers(data, end, headers, &body);
+    bool has_cluster = *dimensions > 2;
+    if (dataset->num_points < max_points) {
+        max_points = dataset->num_points; // never more than the pre-allocated size
+    }
+
+    int count = parse_csv_lines(body, end, dataset, max_points, has_cluster);
+
+    munmap((void *)data, file_size);
+    close(fd);
+
+    // update the dataset length to match the count
+    dataset->num_points = count;
+    return count;
+}
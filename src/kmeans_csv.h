@@ -0,0 +1,14 @@
+#ifndef KMEANS_CSV_H
+#define KMEANS_CSV_H
+
+#include "kmeans.h"
+
+extern int count_csv_points(char *csv_file_name);
+extern int count_csv_lines(const char *start, const char *stop);
+extern int parse_csv_headers(const char *data, const char *end, char *headers[], const char **body);
+extern int parse_csv_lines(const char *body, const char *end, struct pointset *dataset, int max_points,
+                           bool has_cluster);
+extern int mmap_read_csv_file(char *csv_file_name, struct pointset *dataset, int max_points, char *headers[],
+                              int *dimensions);
+
+#endif
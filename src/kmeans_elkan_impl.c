@@ -0,0 +1,247 @@
+/**
+ * Elkan's triangle inequality accelerated implementation of the K-Means Lloyds Algorithm
+ *
+ * For every point an upper bound on the distance to its assigned centroid and a lower bound on
+ * the distance to every other centroid are kept from one iteration to the next, along with the
+ * distances between the centroids. A distance is only calculated when these bounds cannot
+ * prove that the centroid is further away than the assigned one, so in late iterations, when
+ * few points move, almost all of the N x K distance calculations are skipped.
+ *
+ * The clustering is the same as the simple implementation (see kmeans_bounds.h).
+ */
+#include <string.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "kmeans_bounds.h"
+#include "log.h"
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+bool first_assignment = true;
+long distance_calculations = 0; // distances calculated in the current iteration
+
+struct pointset main_dataset;
+struct pointset centroids;
+struct pointset old_centroids;
+double *upper_bounds;       // per point: upper bound on the distance to the assigned centroid
+double *lower_bounds;       // per point and centroid (N x K): lower bound on the distance to the centroid
+double *centroid_distances; // K x K half distances between the centroids
+double *half_separation;    // per centroid: half the distance to the closest other centroid
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    allocate_pointset_points(&main_dataset, max_points);
+    DEBUG("Allocated %d point space", max_points);
+    num_points_total = load_dataset(&main_dataset);
+    INFO("Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+}
+
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    allocate_pointset_points(&old_centroids, num_clusters);
+    initialize_centroids(&main_dataset, &centroids);
+
+    upper_bounds = (double *)malloc(num_points_total * sizeof(double));
+    lower_bounds = (double *)malloc((size_t)num_points_total * num_clusters * sizeof(double));
+    centroid_distances = (double *)malloc(num_clusters * num_clusters * sizeof(double));
+    half_separation = (double *)malloc(num_clusters * sizeof(double));
+    if (upper_bounds == NULL || lower_bounds == NULL || centroid_distances == NULL || half_separation == NULL) {
+        FAIL("Failed to allocate Elkan bounds for %d points and %d clusters", num_points_total, num_clusters);
+    }
+}
+
+/**
+ * First assignment: every distance is calculated, which sets all the bounds exactly
+ */
+static int assign_all_clusters()
+{
+    int num_clusters = centroids.num_points;
+    int cluster_changes = 0;
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        double *lower = lower_bounds + (size_t)n * num_clusters;
+        double min_distance = INFINITY;
+        int closest_cluster = -1;
+        for (int k = 0; k < num_clusters; ++k) {
+            double distance = squared_point_distance(&main_dataset, n, &centroids, k);
+            lower[k] = lower_bound(distance);
+            if (closer_cluster(distance, k, min_distance, closest_cluster)) {
+                min_distance = distance;
+                closest_cluster = k;
+            }
+        }
+        upper_bounds[n] = upper_bound(min_distance);
+        if (main_dataset.cluster_ids[n] != closest_cluster) {
+            main_dataset.cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+        }
+    }
+    distance_calculations = (long)main_dataset.num_points * num_clusters;
+    return cluster_changes;
+}
+
+/**
+ * Distances between all pairs of centroids and half the distance from each to its nearest neighbour
+ */
+static void calculate_centroid_distances()
+{
+    int num_clusters = centroids.num_points;
+    for (int k = 0; k < num_clusters; ++k) {
+        half_separation[k] = INFINITY;
+    }
+    for (int k = 0; k < num_clusters; ++k) {
+        centroid_distances[k * num_clusters + k] = 0.0;
+        for (int j = k + 1; j < num_clusters; ++j) {
+            double diff_x = centroids.x_coords[k] - centroids.x_coords[j];
+            double diff_y = centroids.y_coords[k] - centroids.y_coords[j];
+            double half_distance = 0.5 * lower_bound(diff_x * diff_x + diff_y * diff_y);
+            centroid_distances[k * num_clusters + j] = half_distance;
+            centroid_distances[j * num_clusters + k] = half_distance;
+            if (half_distance < half_separation[k]) half_separation[k] = half_distance;
+            if (half_distance < half_separation[j]) half_separation[j] = half_distance;
+        }
+    }
+}
+
+/**
+ * Assigns each point in the dataset to a cluster based on the distance from that cluster,
+ * skipping every distance calculation that the bounds prove cannot change the assignment.
+ *
+ * The return value indicates how many points were assigned to a _different_ cluster
+ * in this assignment process: this indicates how close the algorithm is to completion.
+ * When the return value is zero, no points changed cluster so the clustering is complete.
+ */
+int assign_clusters()
+{
+    TRACE("Starting Elkan assign_clusters with %d datapoints", main_dataset.num_points);
+    if (first_assignment) {
+        first_assignment = false;
+        return assign_all_clusters();
+    }
+
+    int num_clusters = centroids.num_points;
+    int cluster_changes = 0;
+    distance_calculations = 0;
+    calculate_centroid_distances();
+
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        int assigned = main_dataset.cluster_ids[n];
+        double upper = upper_bounds[n];
+        // no other centroid can be closer if the point is within half way to the nearest one
+        if (upper <= half_separation[assigned]) {
+            continue;
+        }
+        double *lower = lower_bounds + (size_t)n * num_clusters;
+        bool upper_is_exact = false;
+        double assigned_distance = 0.0; // squared, once upper_is_exact
+        for (int k = 0; k < num_clusters; ++k) {
+            if (k == assigned || upper <= lower[k] || upper <= centroid_distances[assigned * num_clusters + k]) {
+                continue;
+            }
+            if (!upper_is_exact) {
+                // tighten the upper bound to the exact distance and check again
+                assigned_distance = squared_point_distance(&main_dataset, n, &centroids, assigned);
+                distance_calculations++;
+                upper = upper_bound(assigned_distance);
+                lower[assigned] = lower_bound(assigned_distance);
+                upper_is_exact = true;
+                if (upper <= lower[k] || upper <= centroid_distances[assigned * num_clusters + k]) {
+                    continue;
+                }
+            }
+            double distance = squared_point_distance(&main_dataset, n, &centroids, k);
+            distance_calculations++;
+            lower[k] = lower_bound(distance);
+            if (closer_cluster(distance, k, assigned_distance, assigned)) {
+                assigned = k;
+                assigned_distance = distance;
+                upper = upper_bound(distance);
+            }
+        }
+        upper_bounds[n] = upper;
+        if (main_dataset.cluster_ids[n] != assigned) {
+            main_dataset.cluster_ids[n] = assigned;
+            cluster_changes++;
+        }
+    }
+
+    VERBOSE("Elkan assignment calculated %ld of %ld distances", distance_calculations,
+            (long)main_dataset.num_points * num_clusters);
+    TRACE("Leaving assign_clusters with %d changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Calculates new centroids for the clusters of the given dataset by finding the
+ * mean x and y coordinates of the current members of the cluster for each cluster,
+ * then moves the bounds of every point by the distance each centroid moved.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    int num_clusters = centroids.num_points;
+    copy_points(&centroids, &old_centroids, 0, num_clusters, false);
+    simple_calculate_centroids(&main_dataset, &centroids);
+
+    double drift[num_clusters];
+    centroid_drift(&old_centroids, &centroids, drift);
+
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        double *lower = lower_bounds + (size_t)n * num_clusters;
+        for (int k = 0; k < num_clusters; ++k) {
+            lower[k] = move_lower_bound(lower[k], drift[k]);
+        }
+        upper_bounds[n] += drift[main_dataset.cluster_ids[n]];
+    }
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    if (changes == 0 || iterations >= max_iterations) {
+        INFO("Done with %d changes after %d iterations", changes, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
+    main_finalize(&main_dataset, metrics, timing);
+}
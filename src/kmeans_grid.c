@@ -0,0 +1,309 @@
+/**
+ * Uniform grid index over the centroids for nearest centroid lookup in 2-D.
+ *
+ * The bounding box of the centroids is split into about GRID_CELLS_PER_CENTROID cells per
+ * centroid and the centroids are binned into the cells with a counting sort, so rebuilding the
+ * grid each time the clusters are assigned (the centroids move) costs O(K). Each point then
+ * starts from its previous cluster and searches outward from its own cell ring by ring, skipping
+ * cells already further than the closest centroid so far, and stops once every cell beyond the
+ * rings searched is further too. Points outside the bounding box start from the nearest edge
+ * cell, and there is nothing to search beyond the edges of the grid.
+ *
+ * The results are identical to simple_assign_clusters: the same distances are compared with
+ * ties going to the lowest cluster index, and the stop bound is narrowed by BOUND_SLACK so no
+ * centroid that could tie is left unsearched.
+ */
+#include <math.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_bounds.h"
+#include "kmeans_grid.h"
+#include "log.h"
+
+#define GRID_CELLS_PER_CENTROID 1
+
+// grid shared by the assignment functions, rebuilt on every call
+static struct centroid_grid assignment_grid;
+
+/**
+ * Column or row of the cell for a coordinate, clamped to the edge cells
+ */
+static inline int grid_cell_index(double coordinate, double min, double cell_size, int cells)
+{
+    double offset = (coordinate - min) / cell_size;
+    if (offset <= 0) return 0;
+    int index = (int)offset;
+    return index < cells ? index : cells - 1;
+}
+
+static inline int grid_cell(struct centroid_grid *grid, double x, double y)
+{
+    int cx = grid_cell_index(x, grid->min_x, grid->cell_width, grid->cells_x);
+    int cy = grid_cell_index(y, grid->min_y, grid->cell_height, grid->cells_y);
+    return cy * grid->cells_x + cx;
+}
+
+/**
+ * Build (or rebuild) the grid for the current centroids
+ */
+void grid_build(struct centroid_grid *grid, struct pointset *centroids)
+{
+    int num_clusters = centroids->num_points;
+    grid->min_x = grid->min_y = INFINITY;
+    grid->max_x = grid->max_y = -INFINITY;
+    for (int k = 0; k < num_clusters; ++k) {
+        double x = centroids->x_coords[k];
+        double y = centroids->y_coords[k];
+        if (x < grid->min_x) grid->min_x = x;
+        if (x > grid->max_x) grid->max_x = x;
+        if (y < grid->min_y) grid->min_y = y;
+        if (y > grid->max_y) grid->max_y = y;
+    }
+
+    int cells_per_side = (int)ceil(sqrt((double)GRID_CELLS_PER_CENTROID * num_clusters));
+    double width = grid->max_x - grid->min_x;
+    double height = grid->max_y - grid->min_y;
+    grid->cells_x = width > 0 ? cells_per_side : 1;
+    grid->cells_y = height > 0 ? cells_per_side : 1;
+    grid->cell_width = width > 0 ? width / grid->cells_x : 1.0;
+    grid->cell_height = height > 0 ? height / grid->cells_y : 1.0;
+
+    int num_cells = grid->cells_x * grid->cells_y;
+    if (grid->capacity_cells < num_cells || grid->capacity_centroids < num_clusters) {
+        free(grid->cell_start);
+        free(grid->cell_centroids);
+        grid->capacity_cells = num_cells;
+        grid->capacity_centroids = num_clusters;
+        grid->cell_start = (int *)malloc((num_cells + 1) * sizeof(int));
+        grid->cell_centroids = (int *)malloc(num_clusters * sizeof(int));
+        if (grid->cell_start == NULL || grid->cell_centroids == NULL) {
+            FAIL("Failed to allocate a grid of %d cells for %d centroids", num_cells, num_clusters);
+        }
+    }
+
+    // counting sort of the centroids by cell: count into the next cell's start, sum up the starts,
+    // then place each centroid at its cell's start moving the start on, which leaves each start
+    // where the next cell's should be, so they are shifted back one cell at the end
+    for (int c = 0; c <= num_cells; ++c) {
+        grid->cell_start[c] = 0;
+    }
+    for (int k = 0; k < num_clusters; ++k) {
+        grid->cell_start[grid_cell(grid, centroids->x_coords[k], centroids->y_coords[k]) + 1]++;
+    }
+    for (int c = 0; c < num_cells; ++c) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    for (int k = 0; k < num_clusters; ++k) {
+        int cell = grid_cell(grid, centroids->x_coords[k], centroids->y_coords[k]);
+        grid->cell_centroids[grid->cell_start[cell]++] = k;
+    }
+    for (int c = num_cells; c > 0; --c) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    }
+    grid->cell_start[0] = 0;
+    DEBUG("Built a %d x %d centroid grid for %d centroids", grid->cells_x, grid->cells_y, num_clusters);
+}
+
+/**
+ * Distance from a coordinate to the band of cells from first to last (zero inside it), less a margin
+ * that covers rounding in the cells chosen for points and centroids
+ */
+static inline double grid_band_gap(double coordinate, double min, double cell_size, int first, int last)
+{
+    double gap = min + first * cell_size - coordinate;
+    double after = coordinate - (min + (last + 1) * cell_size);
+    if (after > gap) gap = after;
+    gap -= cell_size * BOUND_SLACK;
+    return gap > 0 ? gap : 0;
+}
+
+/**
+ * Is everything at least the squared gap away further than the closest centroid so far?
+ * The bounds slack keeps anything that could tie with it.
+ */
+static inline bool beyond_closest(double gap_squared, double min_squared)
+{
+    return gap_squared * (1 - BOUND_SLACK) > min_squared * (1 + BOUND_SLACK);
+}
+
+// the closest centroid found so far in the search for one point
+struct grid_search {
+    double x, y;
+    double min_squared;  // squared distance to the closest, for the bounds
+    double min_distance; // distance compared to choose the closest, as in simple_assign_clusters
+    int closest_cluster;
+};
+
+static inline void grid_search_cell(struct centroid_grid *grid, struct pointset *centroids, int cell,
+                                    bool proper_distance, struct grid_search *search)
+{
+    for (int c = grid->cell_start[cell]; c < grid->cell_start[cell + 1]; ++c) {
+        int k = grid->cell_centroids[c];
+        double squared = squared_centroid_distance(centroids, k, search->x, search->y);
+        double distance = proper_distance ? sqrt(squared) : squared;
+        if (closer_cluster(distance, k, search->min_distance, search->closest_cluster)) {
+            search->min_squared = squared;
+            search->min_distance = distance;
+            search->closest_cluster = k;
+        }
+    }
+}
+
+/**
+ * Search the cells of row cy from cx_first to cx_last that are not already further than the closest
+ */
+static inline void grid_search_row(struct centroid_grid *grid, struct pointset *centroids, int cy,
+                                   int cx_first, int cx_last, bool proper_distance, struct grid_search *search)
+{
+    double dy_gap = grid_band_gap(search->y, grid->min_y, grid->cell_height, cy, cy);
+    if (beyond_closest(dy_gap * dy_gap, search->min_squared)) {
+        return;
+    }
+    for (int cx = cx_first; cx <= cx_last; ++cx) {
+        double dx_gap = grid_band_gap(search->x, grid->min_x, grid->cell_width, cx, cx);
+        if (!beyond_closest(dx_gap * dx_gap + dy_gap * dy_gap, search->min_squared)) {
+            grid_search_cell(grid, centroids, cy * grid->cells_x + cx, proper_distance, search);
+        }
+    }
+}
+
+/**
+ * Search the cells of column cx from cy_first to cy_last that are not already further than the closest
+ */
+static inline void grid_search_column(struct centroid_grid *grid, struct pointset *centroids, int cx,
+                                      int cy_first, int cy_last, bool proper_distance, struct grid_search *search)
+{
+    double dx_gap = grid_band_gap(search->x, grid->min_x, grid->cell_width, cx, cx);
+    if (beyond_closest(dx_gap * dx_gap, search->min_squared)) {
+        return;
+    }
+    for (int cy = cy_first; cy <= cy_last; ++cy) {
+        double dy_gap = grid_band_gap(search->y, grid->min_y, grid->cell_height, cy, cy);
+        if (!beyond_closest(dx_gap * dx_gap + dy_gap * dy_gap, search->min_squared)) {
+            grid_search_cell(grid, centroids, cy * grid->cells_x + cx, proper_distance, search);
+        }
+    }
+}
+
+/**
+ * Assign point n to the closest centroid, searching the rings of cells around the point's cell
+ * (the nearest edge cell for points outside the grid) until every cell beyond the rings searched
+ * is further than the closest centroid found. Cells of a ring that are already further than the
+ * closest are skipped.
+ *
+ * @return true if the point changed cluster
+ */
+static inline bool grid_assign_point(struct centroid_grid *grid, struct pointset *dataset, int n,
+                                     struct pointset *centroids, bool proper_distance)
+{
+    struct grid_search search = {dataset->x_coords[n], dataset->y_coords[n], INFINITY, INFINITY, -1};
+    int cx = grid_cell_index(search.x, grid->min_x, grid->cell_width, grid->cells_x);
+    int cy = grid_cell_index(search.y, grid->min_y, grid->cell_height, grid->cells_y);
+
+    // the point's previous cluster is usually still the closest, which bounds the search from the start
+    int previous = dataset->cluster_ids[n];
+    if (previous >= 0 && previous < centroids->num_points) {
+        search.min_squared = squared_centroid_distance(centroids, previous, search.x, search.y);
+        search.min_distance = proper_distance ? sqrt(search.min_squared) : search.min_squared;
+        search.closest_cluster = previous;
+    }
+
+    // distances from the point to the grid across and down, zero unless it is outside the grid
+    double dx_outside = grid_band_gap(search.x, grid->min_x, grid->cell_width, 0, grid->cells_x - 1);
+    double dy_outside = grid_band_gap(search.y, grid->min_y, grid->cell_height, 0, grid->cells_y - 1);
+    grid_search_cell(grid, centroids, cy * grid->cells_x + cx, proper_distance, &search);
+    for (int ring = 1; ; ++ring) {
+        // the closest of the unsearched cells on each side of the rings searched so far
+        int left = cx - ring + 1;
+        int right = cx + ring - 1;
+        int top = cy - ring + 1;
+        int bottom = cy + ring - 1;
+        double gap_squared = INFINITY;
+        if (left > 0) {
+            double gap = grid_band_gap(search.x, grid->min_x, grid->cell_width, left - 1, left - 1);
+            gap_squared = gap * gap + dy_outside * dy_outside;
+        }
+        if (right < grid->cells_x - 1) {
+            double gap = grid_band_gap(search.x, grid->min_x, grid->cell_width, right + 1, right + 1);
+            if (gap * gap + dy_outside * dy_outside < gap_squared) gap_squared = gap * gap + dy_outside * dy_outside;
+        }
+        if (top > 0) {
+            double gap = grid_band_gap(search.y, grid->min_y, grid->cell_height, top - 1, top - 1);
+            if (gap * gap + dx_outside * dx_outside < gap_squared) gap_squared = gap * gap + dx_outside * dx_outside;
+        }
+        if (bottom < grid->cells_y - 1) {
+            double gap = grid_band_gap(search.y, grid->min_y, grid->cell_height, bottom + 1, bottom + 1);
+            if (gap * gap + dx_outside * dx_outside < gap_squared) gap_squared = gap * gap + dx_outside * dx_outside;
+        }
+        // no cells left (infinite gap) or none of them can hold a closer centroid
+        if (beyond_closest(gap_squared, search.min_squared)) {
+            break;
+        }
+
+        // the next ring: the rows above and below it in full, and the columns either side between them
+        int cx_first = left - 1 > 0 ? left - 1 : 0;
+        int cx_last = right + 1 < grid->cells_x - 1 ? right + 1 : grid->cells_x - 1;
+        int cy_first = top > 0 ? top : 0;
+        int cy_last = bottom < grid->cells_y - 1 ? bottom : grid->cells_y - 1;
+        if (top > 0) {
+            grid_search_row(grid, centroids, top - 1, cx_first, cx_last, proper_distance, &search);
+        }
+        if (bottom < grid->cells_y - 1) {
+            grid_search_row(grid, centroids, bottom + 1, cx_first, cx_last, proper_distance, &search);
+        }
+        if (left > 0) {
+            grid_search_column(grid, centroids, left - 1, cy_first, cy_last, proper_distance, &search);
+        }
+        if (right < grid->cells_x - 1) {
+            grid_search_column(grid, centroids, right + 1, cy_first, cy_last, proper_distance, &search);
+        }
+    }
+    if (dataset->cluster_ids[n] != search.closest_cluster) {
+        dataset->cluster_ids[n] = search.closest_cluster;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Grid indexed version of simple_assign_clusters
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @return the number of points for which the cluster assignment was changed
+ */
+int grid_assign_clusters(struct pointset *dataset, struct pointset *centroids)
+{
+    grid_build(&assignment_grid, centroids);
+    bool proper_distance = kmeans_config->proper_distance;
+    int cluster_changes = 0;
+    for (int n = 0; n < dataset->num_points; ++n) {
+        if (grid_assign_point(&assignment_grid, dataset, n, centroids, proper_distance)) {
+            cluster_changes++;
+        }
+    }
+    return cluster_changes;
+}
+
+/**
+ * Grid indexed and OpenMP parallel version of simple_assign_clusters: the grid is built once
+ * and the points are split over the threads.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @return the number of points for which the cluster assignment was changed
+ */
+int omp_grid_assign_clusters(struct pointset *dataset, struct pointset *centroids)
+{
+    grid_build(&assignment_grid, centroids);
+    bool proper_distance = kmeans_config->proper_distance;
+    int num_points = dataset->num_points;
+    int cluster_changes = 0;
+    #pragma omp parallel for schedule(static) reduction(+:cluster_changes)
+    for (int n = 0; n < num_points; ++n) {
+        if (grid_assign_point(&assignment_grid, dataset, n, centroids, proper_distance)) {
+            cluster_changes++;
+        }
+    }
+    return cluster_changes;
+}
@@ -0,0 +1,22 @@
+#ifndef KMEANS_GRID_H
+#define KMEANS_GRID_H
+
+#include "kmeans.h"
+
+// a uniform grid over the bounding box of the centroids with the centroids binned into its cells
+struct centroid_grid {
+    int cells_x, cells_y;     // number of cells across and down
+    double min_x, max_x;      // bounding box of the centroids
+    double min_y, max_y;
+    double cell_width, cell_height;
+    int *cell_start;          // cell c holds the centroids cell_centroids[cell_start[c]..cell_start[c+1]-1]
+    int *cell_centroids;      // centroid indexes ordered by cell
+    int capacity_cells;       // allocated sizes
+    int capacity_centroids;
+};
+
+extern void grid_build(struct centroid_grid *grid, struct pointset *centroids);
+extern int grid_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+extern int omp_grid_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+
+#endif
@@ -0,0 +1,221 @@
+/**
+ * Hamerly's bounded implementation of the K-Means Lloyds Algorithm
+ *
+ * Like Elkan's algorithm, distance calculations are skipped when triangle inequality bounds
+ * prove they cannot change the assignment, but only two bounds are kept per point: an upper
+ * bound on the distance to the assigned centroid and a single lower bound on the distance to
+ * the second closest centroid. The memory is O(N + K) rather than Elkan's O(N x K) so it suits
+ * the large runs with -n 1000000. When the bounds do not hold, all K distances are calculated
+ * for the point.
+ *
+ * The clustering is the same as the simple implementation (see kmeans_bounds.h).
+ */
+#include <string.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "kmeans_bounds.h"
+#include "log.h"
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+int iteration = 0;
+long skipped_total = 0; // distance calculations skipped over all iterations
+
+struct pointset main_dataset;
+struct pointset centroids;
+struct pointset old_centroids;
+double *upper_bounds;    // per point: upper bound on the distance to the assigned centroid
+double *lower_bounds;    // per point: lower bound on the distance to the second closest centroid
+double *half_separation; // per centroid: half the distance to the closest other centroid
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    allocate_pointset_points(&main_dataset, max_points);
+    DEBUG("Allocated %d point space", max_points);
+    num_points_total = load_dataset(&main_dataset);
+    INFO("Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+}
+
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    allocate_pointset_points(&old_centroids, num_clusters);
+    initialize_centroids(&main_dataset, &centroids);
+
+    upper_bounds = (double *)malloc(num_points_total * sizeof(double));
+    lower_bounds = (double *)malloc(num_points_total * sizeof(double));
+    half_separation = (double *)malloc(num_clusters * sizeof(double));
+    if (upper_bounds == NULL || lower_bounds == NULL || half_separation == NULL) {
+        FAIL("Failed to allocate Hamerly bounds for %d points and %d clusters", num_points_total, num_clusters);
+    }
+}
+
+/**
+ * Calculate the distance from point n to every centroid, assign it to the closest one and
+ * reset its bounds to the closest and second closest distances.
+ *
+ * @return true if the point changed cluster
+ */
+static bool assign_point(int n)
+{
+    int num_clusters = centroids.num_points;
+    double min_distance = INFINITY;
+    double second_distance = INFINITY;
+    int closest_cluster = -1;
+    for (int k = 0; k < num_clusters; ++k) {
+        double distance = squared_point_distance(&main_dataset, n, &centroids, k);
+        if (closer_cluster(distance, k, min_distance, closest_cluster)) {
+            second_distance = min_distance;
+            min_distance = distance;
+            closest_cluster = k;
+        }
+        else if (distance < second_distance) {
+            second_distance = distance;
+        }
+    }
+    upper_bounds[n] = upper_bound(min_distance);
+    lower_bounds[n] = lower_bound(second_distance);
+    if (main_dataset.cluster_ids[n] != closest_cluster) {
+        main_dataset.cluster_ids[n] = closest_cluster;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Assigns each point in the dataset to a cluster based on the distance from that cluster,
+ * skipping the points whose bounds prove that they stay in the same cluster.
+ *
+ * The return value indicates how many points were assigned to a _different_ cluster
+ * in this assignment process: this indicates how close the algorithm is to completion.
+ * When the return value is zero, no points changed cluster so the clustering is complete.
+ */
+int assign_clusters()
+{
+    TRACE("Starting Hamerly assign_clusters with %d datapoints", main_dataset.num_points);
+    int num_clusters = centroids.num_points;
+    int cluster_changes = 0;
+    long distance_calculations = 0;
+
+    if (iteration == 0) {
+        // no bounds yet: the first assignment calculates every distance
+        for (int n = 0; n < main_dataset.num_points; ++n) {
+            if (assign_point(n)) cluster_changes++;
+        }
+        distance_calculations = (long)main_dataset.num_points * num_clusters;
+    }
+    else {
+        centroid_half_separation(&centroids, half_separation);
+        for (int n = 0; n < main_dataset.num_points; ++n) {
+            int assigned = main_dataset.cluster_ids[n];
+            double bound = half_separation[assigned] > lower_bounds[n] ? half_separation[assigned] : lower_bounds[n];
+            if (upper_bounds[n] <= bound) {
+                continue;
+            }
+            // tighten the upper bound to the exact distance and check again
+            upper_bounds[n] = upper_bound(squared_point_distance(&main_dataset, n, &centroids, assigned));
+            distance_calculations++;
+            if (upper_bounds[n] <= bound) {
+                continue;
+            }
+            if (assign_point(n)) cluster_changes++;
+            distance_calculations += num_clusters;
+        }
+    }
+
+    long all_distances = (long)main_dataset.num_points * num_clusters;
+    long skipped = all_distances > distance_calculations ? all_distances - distance_calculations : 0;
+    skipped_total += skipped;
+    INFO("Iteration %d skipped %ld of %ld distance calculations (%.1f%%)", iteration, skipped, all_distances,
+         all_distances > 0 ? 100.0 * skipped / all_distances : 0.0);
+    iteration++;
+    TRACE("Leaving assign_clusters with %d changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Calculates new centroids for the clusters of the given dataset by finding the
+ * mean x and y coordinates of the current members of the cluster for each cluster,
+ * then moves the bounds of every point by the distance the centroids moved.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    int num_clusters = centroids.num_points;
+    copy_points(&centroids, &old_centroids, 0, num_clusters, false);
+    simple_calculate_centroids(&main_dataset, &centroids);
+
+    double drift[num_clusters];
+    centroid_drift(&old_centroids, &centroids, drift);
+
+    // the lower bound covers every other centroid so moves by the largest drift, except for
+    // points in the cluster that drifted furthest, which only need the second largest
+    int furthest = 0;
+    for (int k = 1; k < num_clusters; ++k) {
+        if (drift[k] > drift[furthest]) furthest = k;
+    }
+    double second_furthest_drift = 0.0;
+    for (int k = 0; k < num_clusters; ++k) {
+        if (k != furthest && drift[k] > second_furthest_drift) second_furthest_drift = drift[k];
+    }
+
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        int assigned = main_dataset.cluster_ids[n];
+        upper_bounds[n] += drift[assigned];
+        lower_bounds[n] = move_lower_bound(lower_bounds[n],
+                                           assigned == furthest ? second_furthest_drift : drift[furthest]);
+    }
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    if (changes == 0 || iterations >= max_iterations) {
+        INFO("Done with %d changes after %d iterations", changes, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+    INFO("Skipped %ld of %ld distance calculations in %d iterations", skipped_total,
+         (long)main_dataset.num_points * centroids.num_points * iteration, iteration);
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
+    main_finalize(&main_dataset, metrics, timing);
+}
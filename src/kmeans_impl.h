@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include "kmeans.h"
 
+extern const int engine_options; // the ENGINE_ options this engine supports
+
 extern void initialize(int max_data, struct kmeans_metrics *metrics);
 extern void initialize_representatives(int num_clusters);
 extern int assign_clusters();
@@ -0,0 +1,355 @@
+/**
+ * KD-tree filtering implementation of the K-Means Lloyds Algorithm (Kanungo et al.)
+ *
+ * A kd-tree is built once over the 2-D points, with the bounding box and the coordinate sums and
+ * count of the points cached in every node. Each iteration the tree is walked with the set of
+ * candidate centroids: at each node the candidate closest to the middle of the box is found
+ * and every other candidate that is further away from every point in the box is filtered out.
+ * When a single candidate is left, the whole subtree belongs to that cluster and its cached sums
+ * are added to the cluster sums at once, so the centroid calculation needs no pass over the points.
+ *
+ * Only the leaves that more than one candidate could own are assigned point by point, comparing
+ * squared distances with ties going to the lowest cluster index like simple_assign_clusters.
+ * Centroids are means of the same points but summed in tree order rather than file order.
+ */
+#include <string.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "kmeans_bounds.h"
+#include "log.h"
+
+// maximum number of points in a leaf
+#define KDTREE_LEAF_SIZE 8
+#define NO_CHILD -1
+
+struct kdtree_node {
+    double min_x, max_x, min_y, max_y; // bounding box of the points
+    double sum_x, sum_y;               // sums of the coordinates of the points
+    int count;                         // number of points
+    int start, end;                    // range of the points in point_order
+    int left, right;                   // child nodes or NO_CHILD for a leaf
+    int owner;                         // cluster of every point in the subtree, or NO_CLUSTER_ID if mixed or unknown
+};
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+int num_nodes = 0;
+
+struct pointset main_dataset;
+struct pointset centroids;
+struct kdtree_node *nodes;
+int *point_order;     // point indexes in tree order: the points of a node are contiguous
+double *cluster_sums; // packed per-cluster [sum_x, sum_y, count] filled during assignment
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    allocate_pointset_points(&main_dataset, max_points);
+    DEBUG("Allocated %d point space", max_points);
+    num_points_total = load_dataset(&main_dataset);
+    INFO("Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+}
+
+static inline double point_coord(int n, int dimension)
+{
+    return dimension == 0 ? main_dataset.x_coords[n] : main_dataset.y_coords[n];
+}
+
+/**
+ * Partially order point_order[start..end-1] so that the median point on the given dimension
+ * is at the middle, with no greater point before it and no smaller one after it (quickselect).
+ */
+static void select_median(int start, int end, int dimension)
+{
+    int middle = start + (end - start) / 2;
+    int low = start;
+    int high = end - 1;
+    while (low < high) {
+        double pivot = point_coord(point_order[low + (high - low) / 2], dimension);
+        int i = low;
+        int j = high;
+        while (i <= j) {
+            while (point_coord(point_order[i], dimension) < pivot) i++;
+            while (point_coord(point_order[j], dimension) > pivot) j--;
+            if (i <= j) {
+                int swap = point_order[i];
+                point_order[i] = point_order[j];
+                point_order[j] = swap;
+                i++;
+                j--;
+            }
+        }
+        if (middle <= j) high = j;
+        else if (middle >= i) low = i;
+        else break;
+    }
+}
+
+/**
+ * Build the subtree for the points point_order[start..end-1], splitting the widest side of the
+ * bounding box at the median, and cache its box, sums and count
+ *
+ * @return the index of the new node
+ */
+static int build_node(int start, int end)
+{
+    int index = num_nodes++;
+    struct kdtree_node *node = &nodes[index];
+    node->start = start;
+    node->end = end;
+    node->count = end - start;
+    node->owner = NO_CLUSTER_ID;
+    node->left = NO_CHILD;
+    node->right = NO_CHILD;
+
+    node->min_x = node->min_y = INFINITY;
+    node->max_x = node->max_y = -INFINITY;
+    for (int i = start; i < end; ++i) {
+        double x = main_dataset.x_coords[point_order[i]];
+        double y = main_dataset.y_coords[point_order[i]];
+        if (x < node->min_x) node->min_x = x;
+        if (x > node->max_x) node->max_x = x;
+        if (y < node->min_y) node->min_y = y;
+        if (y > node->max_y) node->max_y = y;
+    }
+
+    if (node->count <= KDTREE_LEAF_SIZE) {
+        node->sum_x = node->sum_y = 0.0;
+        for (int i = start; i < end; ++i) {
+            node->sum_x += main_dataset.x_coords[point_order[i]];
+            node->sum_y += main_dataset.y_coords[point_order[i]];
+        }
+        return index;
+    }
+
+    int dimension = (node->max_x - node->min_x) >= (node->max_y - node->min_y) ? 0 : 1;
+    int middle = start + (end - start) / 2;
+    select_median(start, end, dimension);
+    int left = build_node(start, middle);
+    int right = build_node(middle, end);
+    node->left = left;
+    node->right = right;
+    node->sum_x = nodes[left].sum_x + nodes[right].sum_x;
+    node->sum_y = nodes[left].sum_y + nodes[right].sum_y;
+    return index;
+}
+
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    initialize_centroids(&main_dataset, &centroids);
+
+    cluster_sums = (double *)malloc(num_clusters * CLUSTER_SUMS_STRIDE * sizeof(double));
+    point_order = (int *)malloc(num_points_total * sizeof(int));
+    // a tree with leaves of at least half the leaf size has fewer than 4N/leaf_size nodes
+    int max_nodes = 4 * (num_points_total / KDTREE_LEAF_SIZE + 1);
+    nodes = (struct kdtree_node *)malloc(max_nodes * sizeof(struct kdtree_node));
+    if (cluster_sums == NULL || point_order == NULL || nodes == NULL) {
+        FAIL("Failed to allocate a kd-tree for %d points", num_points_total);
+    }
+    for (int n = 0; n < num_points_total; ++n) {
+        point_order[n] = n;
+    }
+    num_nodes = 0;
+    build_node(0, num_points_total);
+    DEBUG("Built kd-tree with %d nodes over %d points", num_nodes, num_points_total);
+}
+
+static inline void add_to_cluster(int k, double sum_x, double sum_y, int count)
+{
+    double *sums = cluster_sums + k * CLUSTER_SUMS_STRIDE;
+    sums[0] += sum_x;
+    sums[1] += sum_y;
+    sums[2] += count;
+}
+
+/**
+ * Assign every point in the subtree to cluster k, unless the subtree is known to belong to it already
+ *
+ * @return the number of points that changed cluster
+ */
+static int assign_subtree(int index, int k)
+{
+    struct kdtree_node *node = &nodes[index];
+    if (node->owner == k) {
+        return 0;
+    }
+    node->owner = k;
+    if (node->left == NO_CHILD) {
+        int cluster_changes = 0;
+        for (int i = node->start; i < node->end; ++i) {
+            int n = point_order[i];
+            if (main_dataset.cluster_ids[n] != k) {
+                main_dataset.cluster_ids[n] = k;
+                cluster_changes++;
+            }
+        }
+        return cluster_changes;
+    }
+    return assign_subtree(node->left, k) + assign_subtree(node->right, k);
+}
+
+/**
+ * Assign the points of a leaf one by one to the closest of the candidates
+ *
+ * @return the number of points that changed cluster
+ */
+static int assign_leaf(struct kdtree_node *node, int *candidates, int num_candidates)
+{
+    int cluster_changes = 0;
+    int owner = NO_CLUSTER_ID;
+    bool single_owner = true;
+    for (int i = node->start; i < node->end; ++i) {
+        int n = point_order[i];
+        double x = main_dataset.x_coords[n];
+        double y = main_dataset.y_coords[n];
+        double min_distance = INFINITY;
+        int closest_cluster = -1;
+        for (int c = 0; c < num_candidates; ++c) {
+            int k = candidates[c];
+            double distance = squared_centroid_distance(&centroids, k, x, y);
+            if (closer_cluster(distance, k, min_distance, closest_cluster)) {
+                min_distance = distance;
+                closest_cluster = k;
+            }
+        }
+        add_to_cluster(closest_cluster, x, y, 1);
+        if (main_dataset.cluster_ids[n] != closest_cluster) {
+            main_dataset.cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+        }
+        if (i == node->start) owner = closest_cluster;
+        else if (owner != closest_cluster) single_owner = false;
+    }
+    node->owner = single_owner ? owner : NO_CLUSTER_ID;
+    return cluster_changes;
+}
+
+/**
+ * Filter the candidates for the subtree and assign it to them
+ *
+ * @return the number of points that changed cluster
+ */
+static int filter(int index, int *candidates, int num_candidates)
+{
+    struct kdtree_node *node = &nodes[index];
+    if (node->count == 0) {
+        return 0;
+    }
+
+    // the candidate closest to the middle of the box keeps the others out if it is closer everywhere
+    double middle_x = 0.5 * (node->min_x + node->max_x);
+    double middle_y = 0.5 * (node->min_y + node->max_y);
+    int closest = candidates[0];
+    double min_distance = squared_centroid_distance(&centroids, closest, middle_x, middle_y);
+    for (int c = 1; c < num_candidates; ++c) {
+        double distance = squared_centroid_distance(&centroids, candidates[c], middle_x, middle_y);
+        if (closer_cluster(distance, candidates[c], min_distance, closest)) {
+            min_distance = distance;
+            closest = candidates[c];
+        }
+    }
+
+    int remaining[num_candidates];
+    int num_remaining = 0;
+    for (int c = 0; c < num_candidates; ++c) {
+        int z = candidates[c];
+        if (z == closest || !further_from_box(&centroids, z, closest, node->min_x, node->max_x, node->min_y, node->max_y)) {
+            remaining[num_remaining++] = z;
+        }
+    }
+
+    if (num_remaining == 1) {
+        add_to_cluster(closest, node->sum_x, node->sum_y, node->count);
+        return assign_subtree(index, closest);
+    }
+    if (node->left == NO_CHILD) {
+        return assign_leaf(node, remaining, num_remaining);
+    }
+    int cluster_changes = filter(node->left, remaining, num_remaining) +
+                          filter(node->right, remaining, num_remaining);
+    node->owner = nodes[node->left].owner == nodes[node->right].owner ? nodes[node->left].owner : NO_CLUSTER_ID;
+    return cluster_changes;
+}
+
+/**
+ * Assigns each point in the dataset to a cluster based on the distance from that cluster,
+ * filtering the candidate centroids down the kd-tree, and sums up the clusters as it goes.
+ *
+ * The return value indicates how many points were assigned to a _different_ cluster
+ * in this assignment process: this indicates how close the algorithm is to completion.
+ * When the return value is zero, no points changed cluster so the clustering is complete.
+ */
+int assign_clusters()
+{
+    TRACE("Starting kd-tree assign_clusters with %d datapoints", main_dataset.num_points);
+    int num_clusters = centroids.num_points;
+    memset(cluster_sums, 0, num_clusters * CLUSTER_SUMS_STRIDE * sizeof(double));
+    int candidates[num_clusters];
+    for (int k = 0; k < num_clusters; ++k) {
+        candidates[k] = k;
+    }
+    int cluster_changes = filter(0, candidates, num_clusters);
+    TRACE("Leaving assign_clusters with %d changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Calculates new centroids from the cluster sums made in the assignment, which used the
+ * sums cached in the kd-tree for every subtree that was assigned as a whole.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    simple_update_centroids(cluster_sums, &centroids);
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    if (changes == 0 || iterations >= max_iterations) {
+        INFO("Done with %d changes after %d iterations", changes, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
+    main_finalize(&main_dataset, metrics, timing);
+}
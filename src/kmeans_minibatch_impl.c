@@ -0,0 +1,186 @@
+/**
+ * Mini-batch implementation of K-Means (Sculley, "Web-scale k-means clustering")
+ *
+ * Each iteration samples --batch-size points uniformly (with replacement) from the dataset,
+ * assigns them to their closest centroids, then moves each centroid towards its sampled points
+ * with a per-centroid learning rate of 1 / (number of points it has been given so far), so the
+ * centroids settle as they collect points. An iteration costs O(B x K) rather than O(N x K).
+ *
+ * Sampled points rarely all keep their clusters, so the run stops after --iterations rather than
+ * when nothing changes. After the last iteration every point is assigned to its closest centroid
+ * once, so that the output, test and inertia (in the metrics) cover the whole dataset: compare
+ * the inertia with the full engines to judge the quality of the clustering.
+ *
+ * With --threads greater than 1 the batch and the final assignments use OpenMP. The batches
+ * depend only on --seed so the result does not depend on the number of threads.
+ */
+#include <float.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "log.h"
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+bool threaded = false; // true to use the OpenMP kernels when more than one thread is requested
+uint64_t random_state; // state of the random sequence that samples the batches
+
+struct pointset main_dataset;
+struct pointset centroids;
+int batch_size;
+int *batch_points;   // indexes of the points sampled for the current batch
+int *batch_clusters; // closest centroid of each point of the current batch
+long *centroid_counts; // per centroid: number of batch points given to it so far, for the learning rate
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    if (kmeans_config->num_threads > 1) {
+        threaded = true;
+        metrics->num_threads = omp_configure_threads(kmeans_config->num_threads);
+        INFO("Using OpenMP kernels with %d threads", metrics->num_threads);
+    }
+    allocate_pointset_points(&main_dataset, max_points);
+    DEBUG("Allocated %d point space", max_points);
+    num_points_total = load_dataset(&main_dataset);
+    INFO("Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+}
+
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    initialize_centroids(&main_dataset, &centroids);
+
+    batch_size = kmeans_config->batch_size;
+    batch_points = (int *)malloc(batch_size * sizeof(int));
+    batch_clusters = (int *)malloc(batch_size * sizeof(int));
+    centroid_counts = (long *)calloc(num_clusters, sizeof(long));
+    if (batch_points == NULL || batch_clusters == NULL || centroid_counts == NULL) {
+        FAIL("Failed to allocate a batch of %d points for %d clusters", batch_size, num_clusters);
+    }
+    random_state = kmeans_config->seed;
+    INFO("Mini-batch of %d points from %d per iteration", batch_size, num_points_total);
+}
+
+/**
+ * Closest centroid to point n, with the distance measure of simple_assign_clusters
+ */
+static inline int closest_centroid(int n)
+{
+    double min_distance = DBL_MAX;
+    int closest_cluster = -1;
+    for (int k = 0; k < centroids.num_points; ++k) {
+        double distance = euclidean_distance(main_dataset.x_coords[n], main_dataset.y_coords[n],
+                                             centroids.x_coords[k], centroids.y_coords[k]);
+        if (distance < min_distance) {
+            min_distance = distance;
+            closest_cluster = k;
+        }
+    }
+    return closest_cluster;
+}
+
+/**
+ * Samples a new batch and assigns each of its points to the closest centroid.
+ *
+ * @return the number of sampled points that changed cluster
+ */
+int assign_clusters()
+{
+    TRACE("Starting mini-batch assign_clusters with %d points", batch_size);
+    // sample sequentially so that the batches do not depend on the number of threads
+    for (int b = 0; b < batch_size; ++b) {
+        batch_points[b] = (int)(random_fraction(&random_state) * num_points_total);
+    }
+
+    int cluster_changes = 0;
+    #pragma omp parallel for schedule(static) if(threaded)
+    for (int b = 0; b < batch_size; ++b) {
+        batch_clusters[b] = closest_centroid(batch_points[b]);
+    }
+    // a point may be sampled more than once in a batch so the changes are counted afterwards
+    for (int b = 0; b < batch_size; ++b) {
+        int n = batch_points[b];
+        if (main_dataset.cluster_ids[n] != batch_clusters[b]) {
+            main_dataset.cluster_ids[n] = batch_clusters[b];
+            cluster_changes++;
+        }
+    }
+    TRACE("Leaving assign_clusters with %d changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Moves each centroid towards the batch points assigned to it, with a learning rate of one over
+ * the number of points the centroid has been given: the centroid is the running mean of them.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    for (int b = 0; b < batch_size; ++b) {
+        int n = batch_points[b];
+        int k = batch_clusters[b];
+        double learning_rate = 1.0 / (double)++centroid_counts[k];
+        centroids.x_coords[k] += learning_rate * (main_dataset.x_coords[n] - centroids.x_coords[k]);
+        centroids.y_coords[k] += learning_rate * (main_dataset.y_coords[n] - centroids.y_coords[k]);
+    }
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    // changes only cover the sampled points so they cannot show that the clustering is complete
+    if (iterations >= max_iterations) {
+        INFO("Done with %d changes in the last batch after %d iterations", changes, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+
+    // assign every point to the final centroids: counted in the assignment and total seconds
+    double start = omp_get_wtime();
+    int changes = threaded ? omp_assign_clusters(&main_dataset, &centroids)
+                           : simple_assign_clusters(&main_dataset, &centroids);
+    double seconds = omp_get_wtime() - start;
+    timing->accumulated_assignment_seconds += seconds;
+    timing->elapsed_total_seconds += seconds;
+    INFO("Final assignment of all %d points changed %d clusters in %f seconds", num_points_total, changes, seconds);
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
+    main_finalize(&main_dataset, metrics, timing);
+}
@@ -13,11 +13,15 @@
 #endif
 #include "mpi_log.h"
 #include "kmeans_sequential.h"
+#include "kmeans_mpi_support.h"
 
+const int engine_options = ENGINE_PACKED_TRANSFER;
 bool done = false;
 int mpi_rank = 0;
 int mpi_world_size = 0;
 int num_points_node = 0; // number of points handled by this node
+int *node_counts;        // number of points handled by each node
+int *node_displacements; // offset of the first point of each node in the main dataset
 int num_points_total = 0;
 bool is_root;
 char node_label[20];
@@ -28,7 +32,7 @@ struct pointset centroids;
 
 void mpi_log_centroids(int level, char *label)
 {
-    if (log_level < level) return;
+    if (!LOG_ENABLED(level)) return;
     mpi_log(level, "Centroids: %s", label);
     char full_label[256];
     sprintf(full_label, "%s : %s", node_label, label);
@@ -39,7 +43,7 @@ void mpi_log_centroids(int level, char *label)
 
 void mpi_log_dataset(int level, struct pointset *pointset, char *label)
 {
-    if (log_level < level) return;
+    if (!LOG_ENABLED(level)) return;
     mpi_log(level, "Dataset: %s", label);
     char full_label[256];
     sprintf(full_label, "%s%s ", node_label, label);
@@ -81,25 +85,21 @@ void initialize(int max_points, struct kmeans_metrics *metrics)
         mpi_log(debug, "Allocated %d point space", max_points);
         num_points_total = load_dataset(&main_dataset);
         mpi_log(info, "Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
-
-        // number of points managed by each subnode is the total number divided by processes
-        // plus 1 in case of remainder (number of points is not is not an even multiple of processors)
-        num_points_node = num_points_total / mpi_world_size;
-        if (num_points_total % mpi_world_size > 0) {
-            num_points_node += 1;
-            mpi_log(debug, "Calculated subnode dataset size: %d / %d (+ 1?) = %d",
-                    num_points_total, mpi_world_size, num_points_node);
-        }
     }
 
-    // broadcast from root to sub nodes, or receive to make the calculation from root
-    MPI_Bcast(&num_points_node, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    mpi_log(debug, "Got %d as num_points_subnode after broadcast", num_points_node);
+    // broadcast the total from root so that every node can calculate the same split of the points
+    MPI_Bcast(&num_points_total, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    node_counts = (int *)malloc(mpi_world_size * sizeof(int));
+    node_displacements = (int *)malloc(mpi_world_size * sizeof(int));
+    mpi_partition_points(num_points_total, mpi_world_size, node_counts, node_displacements);
+    num_points_node = node_counts[mpi_rank];
+    mpi_log(debug, "Calculated subnode dataset size: %d of %d at %d",
+            num_points_node, num_points_total, node_displacements[mpi_rank]);
 
     // Create a subnode dataset on each subnode, independent of the main dataset
     // Note: the root node also has a node_dataset since scatter will assign_clusters IT a subset
     //       of the total dataset along with all the other subnodes
-    allocate_pointset_points(&node_dataset, num_points_node);
+    mpi_allocate_node_pointset(&node_dataset, num_points_node);
     mpi_log(debug, "Allocated subnode dataset to %d points", num_points_node);
 //    MPI_Barrier(MPI_COMM_WORLD);
 }
@@ -109,15 +109,7 @@ void initialize(int max_points, struct kmeans_metrics *metrics)
  */
 void mpi_scatter_dataset()
 {
-    mpi_log(debug, "Starting scatter of %d points", num_points_node);
-    MPI_Scatter(main_dataset.x_coords, num_points_node, MPI_DOUBLE,
-                node_dataset.x_coords, num_points_node, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Scatter(main_dataset.y_coords, num_points_node, MPI_DOUBLE,
-                node_dataset.y_coords, num_points_node, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Scatter(main_dataset.cluster_ids, num_points_node, MPI_INT,
-                node_dataset.cluster_ids, num_points_node, MPI_INT, 0, MPI_COMM_WORLD);
-    mpi_log(debug, "Scattered/Received %d points to/from other nodes. First x_coord is %.2f",
-            num_points_node, node_dataset.x_coords[0]);
+    mpi_scatter_pointset(&main_dataset, &node_dataset, node_counts, node_displacements);
     mpi_log_dataset(debug, &node_dataset, "After Scatter ");
 }
 
@@ -126,14 +118,7 @@ void mpi_scatter_dataset()
  */
 void mpi_gather_dataset()
 {
-    mpi_log(debug, "Starting Gather of subset with %d points:", num_points_node);
-    MPI_Gather(node_dataset.x_coords, num_points_node, MPI_DOUBLE,
-               main_dataset.x_coords, num_points_node, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Gather(node_dataset.y_coords, num_points_node, MPI_DOUBLE,
-               main_dataset.y_coords, num_points_node, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Gather(node_dataset.cluster_ids, num_points_node, MPI_INT,
-               main_dataset.cluster_ids, num_points_node, MPI_INT, 0, MPI_COMM_WORLD);
-    mpi_log(debug, "Done Gathering");
+    mpi_gather_pointset(&node_dataset, &main_dataset, node_counts, node_displacements);
     mpi_log_dataset(debug, &main_dataset, "After Gather");
 }
 
@@ -275,6 +260,7 @@ void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
     mpi_log(debug, "Finalizing");
     if (is_root) {
         metrics->num_points = num_points_total;
+        metrics->inertia = cluster_inertia(&main_dataset, &centroids);
         main_finalize(&main_dataset, metrics, timing);
     }
     // else the subnodes do not run the main loop but all mpi nodes must finalize
@@ -0,0 +1,524 @@
+/**
+ * MPI Implementation of the K-Means Lloyds Algorithm with the dataset resident on the nodes
+ *
+ * Unlike kmeans_mpi1, the dataset is scattered to the nodes once at startup and each node
+ * keeps its subset of points for the whole run. Only the per-cluster partial sums and the
+ * cluster change counts are sent between nodes in each iteration, and the cluster ids
+ * are gathered back to the root once, at the end of the run.
+ *
+ * When built with KMEANS_HYBRID (the kmeans_hybrid target) each process also splits the
+ * assignment of its points and the accumulation of the partial sums over OpenMP threads,
+ * so it can run one process per node or socket.
+ *
+ * With --incremental each node keeps the partial sums of its points between iterations and
+ * only moves the points that change cluster, so after the first few iterations the node work
+ * for the centroids is proportional to the changes rather than to the points on the node.
+ *
+ * With --mpi-io there is no scatter either: every node reads its own part of the input file
+ * with MPI-IO, so the root never loads the whole dataset. Only the first K points are gathered
+ * to the root for --init first, --init kmeans++ is refused (use --init kmeans||), and all the
+ * points are only gathered to the root for the test comparison or the verbose listing.
+ *
+ * The output file is always written by all the nodes together: each node formats its own points
+ * and writes them with MPI-IO after the points of the nodes before it.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "log.h"
+
+// MPI specific includes
+#ifdef __APPLE__
+#include "/opt/openmpi/include/mpi.h"
+#else
+#include <mpi.h>
+#endif
+#include "mpi_log.h"
+#include "kmeans_sequential.h"
+#include "kmeans_mpi_support.h"
+#include "kmeans_simd.h"
+#include "kmeans_grid.h"
+
+#ifdef KMEANS_HYBRID
+#define node_assign_clusters omp_assign_clusters
+#define node_simd_assign_clusters omp_simd_assign_clusters
+#define node_grid_assign_clusters omp_grid_assign_clusters
+#define node_assign_accumulate_clusters omp_assign_accumulate_clusters
+#define node_assign_move_clusters omp_assign_move_clusters
+#define node_accumulate_clusters omp_accumulate_clusters
+#else
+#define node_assign_clusters simple_assign_clusters
+#define node_simd_assign_clusters simd_assign_clusters
+#define node_grid_assign_clusters grid_assign_clusters
+#define node_assign_accumulate_clusters simple_assign_accumulate_clusters
+#define node_assign_move_clusters simple_assign_move_clusters
+#define node_accumulate_clusters simple_accumulate_clusters
+#endif
+
+const int engine_options = ENGINE_SINGLE_PASS | ENGINE_SIMD | ENGINE_GRID | ENGINE_INCREMENTAL |
+                           ENGINE_PACKED_TRANSFER | ENGINE_FUSED_REDUCTION | ENGINE_MPI_IO;
+bool done = false;
+int mpi_rank = 0;
+int mpi_world_size = 0;
+int num_points_node = 0; // number of points handled by this node
+int *node_counts;        // number of points handled by each node
+int *node_displacements; // offset of the first point of each node in the main dataset
+int num_points_total = 0;
+bool is_root;
+bool main_dataset_loaded; // true when the root has every point in main_dataset
+bool sums_in_assignment;  // true when the node sums are made by the assignment (--single-pass or --incremental)
+int assignments = 0;      // number of calls to assign_clusters, for the incremental refresh
+char node_label[20];
+
+struct pointset main_dataset;
+struct pointset node_dataset;
+struct pointset centroids;
+double *node_cluster_sums;   // [sum_x, sum_y, count] per cluster for the points on this node
+double *total_cluster_sums;  // sums reduced over all nodes, the same on every node
+
+void mpi_log_centroids(int level, char *label)
+{
+    if (!LOG_ENABLED(level)) return;
+    mpi_log(level, "Centroids: %s", label);
+    node_color();
+    print_centroids(stdout, &centroids, node_label);
+    reset_color();
+}
+
+void mpi_log_dataset(int level, struct pointset *pointset, char *label)
+{
+    if (!LOG_ENABLED(level)) return;
+    mpi_log(level, "Dataset: %s", label);
+    char full_label[256];
+    sprintf(full_label, "%s%s ", node_label, label);
+    node_color();
+    print_points(stdout, pointset, full_label);
+    reset_color();
+}
+
+/**
+ * Distribute dataset as subsets to other nodes - including a subset to the root node.
+ * This is done once only: the points are then resident on the nodes for the whole run.
+ */
+void mpi_scatter_dataset()
+{
+    mpi_scatter_pointset(&main_dataset, &node_dataset, node_counts, node_displacements);
+    mpi_log_dataset(debug, &node_dataset, "After Scatter ");
+}
+
+/**
+ * Gather back the cluster assignments to the root node from the various processes (including the root)
+ * The coordinates never change so only the cluster ids are needed.
+ */
+void mpi_gather_clusters()
+{
+    mpi_gather_cluster_ids(&node_dataset, &main_dataset, node_counts, node_displacements);
+    mpi_log_dataset(debug, &main_dataset, "After Gather");
+}
+
+/**
+ * Read the subset of points for this node straight from the input file with MPI-IO: the nodes
+ * read their parts of the file in parallel and the root does not load the full dataset.
+ */
+void mpi_read_dataset()
+{
+    char *headers[3];
+    int dimensions = 0;
+    double load_start = MPI_Wtime();
+    num_points_total = mpi_read_node_pointset(valid_file('f', kmeans_config->in_file), kmeans_config->max_points,
+                                              &node_dataset, node_counts, node_displacements, headers, &dimensions);
+    num_points_node = node_counts[mpi_rank];
+    main_dataset_loaded = false;
+    if (is_root) {
+        set_dataset_headers(headers, dimensions, MPI_Wtime() - load_start);
+    }
+    mpi_log(info, "Read %d of %d points at %d with MPI-IO",
+            num_points_node, num_points_total, node_displacements[mpi_rank]);
+    mpi_log_dataset(debug, &node_dataset, "After MPI-IO read ");
+}
+
+/**
+ * Gather every point to the root node, for a dataset read with MPI-IO when the root needs
+ * the whole dataset after all
+ */
+void mpi_gather_dataset()
+{
+    if (is_root) {
+        allocate_pointset_points(&main_dataset, num_points_total > 0 ? num_points_total : 1);
+        main_dataset.num_points = num_points_total;
+    }
+    mpi_gather_pointset(&node_dataset, &main_dataset, node_counts, node_displacements);
+    main_dataset_loaded = true;
+    mpi_log_dataset(debug, &main_dataset, "After Gather");
+}
+
+/**
+ * Gather the first num_points points of the dataset to the root, from whichever nodes have
+ * them, for --init first without the whole dataset on the root
+ *
+ * @param first_points unallocated pointset, allocated and filled on the root only: it has fewer
+ *                     points when the dataset itself has fewer
+ * @param num_points number of points to gather
+ */
+void mpi_gather_first_points(struct pointset *first_points, int num_points)
+{
+    int *counts = (int *)malloc(mpi_world_size * sizeof(int));
+    int *displacements = (int *)malloc(mpi_world_size * sizeof(int));
+    int gathered = 0;
+    for (int rank = 0; rank < mpi_world_size; ++rank) {
+        int wanted = num_points - node_displacements[rank];
+        counts[rank] = wanted < 0 ? 0 : (wanted > node_counts[rank] ? node_counts[rank] : wanted);
+        displacements[rank] = gathered;
+        gathered += counts[rank];
+    }
+    if (is_root) {
+        allocate_pointset_points(first_points, gathered > 0 ? gathered : 1);
+        first_points->num_points = gathered;
+    }
+    else {
+        first_points->x_coords = NULL;
+        first_points->y_coords = NULL;
+        first_points->cluster_ids = NULL;
+        first_points->num_points = 0;
+    }
+    struct pointset node_first = node_dataset;
+    node_first.num_points = counts[mpi_rank];
+    mpi_gather_pointset(&node_first, first_points, counts, displacements);
+    free(counts);
+    free(displacements);
+}
+
+/**
+ * Write the output file from all the nodes: each node formats its own points in the csv format
+ * of write_csv_file (the root adds the headers) and they are written in order with MPI-IO
+ */
+void mpi_write_output()
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&text, &size);
+    if (stream == NULL) {
+        FAIL("Cannot format the output of %d points on node %d", node_dataset.num_points, mpi_rank);
+    }
+    if (is_root) {
+        write_dataset_headers(stream);
+    }
+    print_points(stream, &node_dataset, NULL);
+    fclose(stream);
+    mpi_write_ordered(kmeans_config->out_file, text, (long long)size);
+    free(text);
+}
+
+/**
+ * Broadcast the centroids values to all nodes
+ */
+void mpi_broadcast_centroids()
+{
+    mpi_log(debug, "Broadcasting centroids");
+    MPI_Bcast(centroids.x_coords, centroids.num_points, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(centroids.y_coords, centroids.num_points, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&centroids.num_points, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    mpi_log(debug, "DONE Broadcasting centroids");
+    mpi_log_centroids(trace, "after broadcast");
+}
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+#ifdef KMEANS_HYBRID
+    // only the main thread of each process makes MPI calls, outside the parallel regions
+    int provided;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+    metrics->num_threads = omp_configure_threads(kmeans_config->num_threads);
+#else
+    MPI_Init(NULL, NULL);
+#endif
+
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_world_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    is_root = mpi_rank == 0;
+    if (is_root) {
+        sprintf(node_label, "Root %d: ", mpi_rank);
+    }
+    else {
+        sprintf(node_label, "Node %d: ", mpi_rank);
+    }
+
+    if (IS_DEBUG) {
+        // Get the name of the processor
+        char processor_name[MPI_MAX_PROCESSOR_NAME];
+        int name_len;
+        MPI_Get_processor_name(processor_name, &name_len);
+        mpi_log(debug, "Processor %s, rank %d out of %d processors\n",
+                processor_name, mpi_rank, mpi_world_size);
+    }
+
+    mpi_log(debug, "Initializing dataset");
+    if (is_root) {
+        metrics->num_processors=mpi_world_size;
+    }
+    node_counts = (int *)malloc(mpi_world_size * sizeof(int));
+    node_displacements = (int *)malloc(mpi_world_size * sizeof(int));
+    if (kmeans_config->mpi_io) {
+        mpi_read_dataset();
+    }
+    else {
+        if (is_root) {
+            // for root we actually load the dataset, for others we just return the empty one
+            allocate_pointset_points(&main_dataset, max_points);
+            mpi_log(debug, "Allocated %d point space", max_points);
+            num_points_total = load_dataset(&main_dataset);
+            mpi_log(info, "Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+        }
+        main_dataset_loaded = true;
+
+        // broadcast the total from root so that every node can calculate the same split of the points
+        MPI_Bcast(&num_points_total, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        mpi_partition_points(num_points_total, mpi_world_size, node_counts, node_displacements);
+        num_points_node = node_counts[mpi_rank];
+        mpi_log(debug, "Calculated subnode dataset size: %d of %d at %d",
+                num_points_node, num_points_total, node_displacements[mpi_rank]);
+
+        mpi_allocate_node_pointset(&node_dataset, num_points_node);
+        mpi_log(debug, "Allocated subnode dataset to %d points", num_points_node);
+
+        mpi_scatter_dataset();
+    }
+    sums_in_assignment = kmeans_config->single_pass || kmeans_config->incremental;
+    if (kmeans_config->simd) {
+        mpi_log(info, "Using %s SIMD assignment kernel", simd_isa_name());
+    }
+}
+
+/**
+ * Reduce the partial sums of every node together with the change counts, in a single
+ * MPI_Allreduce, and return the total number of changes over all nodes.
+ *
+ * The change count is packed into the slot after the per-cluster sums, so that every node
+ * gets both the totals for the centroids and the count for the done decision from the same
+ * collective: with the fused reduction one iteration costs exactly one collective call.
+ */
+int mpi_reduce_sums_and_changes(int node_reassignments)
+{
+    int num_clusters = centroids.num_points;
+    int changes_index = num_clusters * CLUSTER_SUMS_STRIDE;
+    node_cluster_sums[changes_index] = node_reassignments;
+
+    MPI_Allreduce(node_cluster_sums, total_cluster_sums, changes_index + 1,
+                  MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return (int)total_cluster_sums[changes_index];
+}
+
+/**
+ * Assigns each point in the node dataset to a cluster based on the distance from that cluster.
+ *
+ * The return value indicates how many points were assigned to a _different_ cluster
+ * in this assignment process over all nodes. It is only meaningful on the root node unless
+ * the reduction is fused, in which case the partial sums for the centroids are accumulated
+ * and reduced here too and every node gets the same count.
+ */
+int assign_clusters()
+{
+    mpi_log(trace, "Starting assign_clusters with %d datapoints", node_dataset.num_points);
+    int total_reassignments = 0;
+    int node_reassignments;
+    bool refresh = assignments++ % INCREMENTAL_REFRESH_ITERATIONS == 0;
+    if (kmeans_config->incremental && !refresh) {
+        // node sums are kept from the last iteration and only the points that change cluster are moved
+        node_reassignments = node_assign_move_clusters(&node_dataset, &centroids, node_cluster_sums);
+    }
+    else if (sums_in_assignment) {
+        node_reassignments = node_assign_accumulate_clusters(&node_dataset, &centroids, node_cluster_sums);
+    }
+    else if (kmeans_config->simd) {
+        node_reassignments = node_simd_assign_clusters(&node_dataset, &centroids);
+    }
+    else if (kmeans_config->grid) {
+        node_reassignments = node_grid_assign_clusters(&node_dataset, &centroids);
+    }
+    else {
+        node_reassignments = node_assign_clusters(&node_dataset, &centroids);
+    }
+
+    if (kmeans_config->fused_reduction) {
+        if (!sums_in_assignment) {
+            node_accumulate_clusters(&node_dataset, node_cluster_sums, centroids.num_points);
+        }
+        total_reassignments = mpi_reduce_sums_and_changes(node_reassignments);
+    }
+    else {
+        MPI_Reduce(&node_reassignments, &total_reassignments, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    mpi_log(trace, "Leaving assign_clusters with %d node, %d total cluster reassignments",
+            node_reassignments, total_reassignments);
+    return total_reassignments;
+}
+
+/**
+ * Calculates new centroids from the per-cluster partial sums of x and y coordinates and
+ * counts computed by each node over its own points.
+ *
+ * The packed partial sums are combined with a single MPI_Allreduce so that every node
+ * ends up with the same totals and calculates the new centroids itself: there is no
+ * serial step on the root and no separate broadcast of the centroids.
+ * With the fused reduction the totals are already reduced in assign_clusters, and with
+ * --single-pass or --incremental the partial sums were already made during the assignment.
+ */
+void calculate_centroids()
+{
+    mpi_log(trace, "Starting calculate_centroids");
+    int num_clusters = centroids.num_points;
+    if (!kmeans_config->fused_reduction) {
+        if (!sums_in_assignment) {
+            node_accumulate_clusters(&node_dataset, node_cluster_sums, num_clusters);
+        }
+        MPI_Allreduce(node_cluster_sums, total_cluster_sums, num_clusters * CLUSTER_SUMS_STRIDE,
+                      MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    simple_update_centroids(total_cluster_sums, &centroids);
+    mpi_log_centroids(trace, "post-calc-centroids");
+    mpi_log(trace, "Leaving calculate_centroids");
+}
+
+void initialize_representatives(int num_clusters)
+{
+    // all nodes need a centroids point set and space for the partial sums
+    allocate_pointset_points(&centroids, num_clusters);
+    // one extra slot after the sums holds the change count for the fused reduction
+    node_cluster_sums = (double *)malloc((num_clusters * CLUSTER_SUMS_STRIDE + 1) * sizeof(double));
+    total_cluster_sums = (double *)malloc((num_clusters * CLUSTER_SUMS_STRIDE + 1) * sizeof(double));
+    if (node_cluster_sums == NULL || total_cluster_sums == NULL) {
+        FAIL("Failed to allocate partial sums for %d clusters", num_clusters);
+    }
+
+    if (kmeans_config->init_method == init_kmeans_parallel) {
+        // every node samples candidates from its own points and the root chooses from those
+        mpi_log(debug, "Initialize centroids with k-means|| over %d nodes", mpi_world_size);
+        mpi_kmeans_parallel_centroids(&node_dataset, node_counts, node_displacements, &centroids,
+                                      kmeans_config->seed);
+    }
+    else if (!main_dataset_loaded) {
+        // --init first after --mpi-io (kmeans++ is refused by validate_config): only the first K points
+        struct pointset first_points;
+        mpi_gather_first_points(&first_points, num_clusters);
+        if (is_root) {
+            mpi_log(debug, "Initialize centroids in root node (%d) from %d gathered points", mpi_rank,
+                    first_points.num_points);
+            initialize_centroids(&first_points, &centroids);
+            free(first_points.x_coords);
+            free(first_points.y_coords);
+            free(first_points.cluster_ids);
+        }
+    }
+    else if (is_root) {
+        mpi_log(debug, "Initialize centroids in root node (%d)", mpi_rank);
+        initialize_centroids(&main_dataset, &centroids);
+    }
+    mpi_broadcast_centroids();
+}
+
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    if (kmeans_config->fused_reduction) {
+        // every node has the same total changes from the fused reduction so
+        // each can make the same decision without another collective
+        if (changes == 0 || iterations >= max_iterations) {
+            mpi_log(info, "Done with %d changes after %d iterations", changes, iterations);
+            done = true;
+        }
+        return done;
+    }
+
+    // only root completes the loop
+    if (is_root) {
+        if (changes == 0 || iterations >= max_iterations) {
+            mpi_log(info, "ROOT is done with %d changes after %d iterations", changes, iterations);
+            done = true;
+        }
+    }
+    mpi_log(debug, "Broadcasting done");
+    MPI_Bcast(&done, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    mpi_log(debug, "AFter broadcast done: %d", done);
+    return done;
+}
+
+/**
+ * All timing is performed only in the root process
+ */
+void start_main_timing(struct kmeans_timing *timing)
+{
+    if (is_root) {
+        simple_start_main_timing(timing);
+    }
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    if (is_root) {
+        simple_start_iteration_timing(timing);
+    }
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    if (is_root) {
+        simple_between_assignment_centroids(timing);
+    }
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    if (is_root) {
+        simple_end_iteration_timing(timing);
+    }
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    if (is_root) {
+        simple_end_main_timing(timing, iterations);
+    }
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    mpi_log(debug, "Running main loop");
+    main_loop(max_iterations, timing);
+    mpi_log(debug, "Main loop completed");
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    mpi_log(debug, "Finalizing");
+    // output file is not always written: sometimes we only run for metrics and compare with test data
+    if (kmeans_config->out_file) {
+        if (is_root) {
+            INFO("Writing output to %s\n", kmeans_config->out_file);
+        }
+        mpi_write_output();
+    }
+    // the full set of cluster assignments is only needed on the root to test or list the results
+    bool gathered = kmeans_config->test_file || IS_VERBOSE;
+    if (gathered && main_dataset_loaded) {
+        mpi_gather_clusters();
+    }
+    else if (gathered) {
+        mpi_gather_dataset();
+    }
+    double node_inertia = cluster_inertia(&node_dataset, &centroids);
+    double inertia = 0;
+    MPI_Reduce(&node_inertia, &inertia, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (is_root) {
+        metrics->num_points = num_points_total;
+        metrics->inertia = inertia;
+        if (gathered) {
+            main_test_report(&main_dataset, metrics, timing);
+        }
+        else {
+            // nothing needs the points on the root: only the metrics are reported
+            main_report(metrics, timing);
+        }
+    }
+    MPI_Finalize();
+}
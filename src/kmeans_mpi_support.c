@@ -0,0 +1,838 @@
+/**
+ * Support functions shared by the MPI implementations for distributing a pointset
+ * over the nodes and collecting it back on the root node, for reading each node's part
+ * of the input file with MPI-IO, and for choosing the initial centroids from the points
+ * distributed over the nodes.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_csv.h"
+#include "kmeans_binary.h"
+#include "kmeans_sequential.h"
+#include "kmeans_mpi_support.h"
+#include "log.h"
+
+// MPI specific includes
+#ifdef __APPLE__
+#include "/opt/openmpi/include/mpi.h"
+#else
+#include <mpi.h>
+#endif
+#include "mpi_log.h"
+
+// staging buffers for packed transfers, grown as needed and reused between calls:
+// the subset of points on this node and (on root only) the full dataset
+static struct point *packed_node_points = NULL;
+static int packed_node_capacity = 0;
+static struct point *packed_main_points = NULL;
+static int packed_main_capacity = 0;
+static MPI_Datatype mpi_point = MPI_DATATYPE_NULL;
+
+// largest number of bytes read from or written to a file by one MPI-IO call
+#define MPI_IO_MAX_BYTES (1 << 30)
+// bytes read at a time when looking for the end of a line in the input file
+#define MPI_IO_LINE_BLOCK 4096
+
+/**
+ * Split the points as evenly as possible over the nodes.
+ *
+ * Every node gets num_points / world_size points and the remainder is spread one point
+ * each over the first nodes, so the sizes differ by at most one point and no padding is
+ * needed when the number of points is not a multiple of the number of nodes.
+ *
+ * @param num_points total number of points in the dataset
+ * @param world_size number of nodes
+ * @param counts pre-allocated array of world_size counts to be filled
+ * @param displacements pre-allocated array of world_size offsets of each node's first point
+ */
+void mpi_partition_points(int num_points, int world_size, int *counts, int *displacements)
+{
+    int base_count = num_points / world_size;
+    int remainder = num_points % world_size;
+    int offset = 0;
+    for (int rank = 0; rank < world_size; ++rank) {
+        counts[rank] = base_count + (rank < remainder ? 1 : 0);
+        displacements[rank] = offset;
+        offset += counts[rank];
+    }
+}
+
+/**
+ * Allocate the subset of points for a node, which may legitimately have no points
+ * at all when there are more nodes than points.
+ */
+void mpi_allocate_node_pointset(struct pointset *node_dataset, int num_points)
+{
+    // always allocate at least one point so that malloc(0) is not mistaken for a failure
+    allocate_pointset_points(node_dataset, num_points > 0 ? num_points : 1);
+    node_dataset->num_points = num_points;
+}
+
+/**
+ * The MPI datatype matching struct point: two doubles and the cluster id, resized to the
+ * extent of the C struct so that arrays of points (including any padding) can be sent.
+ * Created and committed on first use.
+ */
+static MPI_Datatype mpi_point_type()
+{
+    if (mpi_point == MPI_DATATYPE_NULL) {
+        int block_lengths[3] = {1, 1, 1};
+        MPI_Aint offsets[3] = {offsetof(struct point, x), offsetof(struct point, y),
+                               offsetof(struct point, cluster)};
+        MPI_Datatype types[3] = {MPI_DOUBLE, MPI_DOUBLE, MPI_INT};
+        MPI_Datatype point_struct;
+        MPI_Type_create_struct(3, block_lengths, offsets, types, &point_struct);
+        MPI_Type_create_resized(point_struct, 0, sizeof(struct point), &mpi_point);
+        MPI_Type_commit(&mpi_point);
+        MPI_Type_free(&point_struct);
+    }
+    return mpi_point;
+}
+
+/**
+ * Make sure a staging buffer can hold at least num_points packed points
+ */
+static struct point *packed_buffer(struct point **buffer, int *capacity, int num_points)
+{
+    if (num_points > *capacity) {
+        free(*buffer);
+        *capacity = num_points;
+        *buffer = (struct point *)malloc(num_points * sizeof(struct point));
+        if (*buffer == NULL) {
+            FAIL("Failed to allocate a packed buffer of %d points", num_points);
+        }
+    }
+    return *buffer;
+}
+
+static void pack_points(struct pointset *pointset, int count, struct point *packed)
+{
+    for (int n = 0; n < count; ++n) {
+        packed[n].x = pointset->x_coords[n];
+        packed[n].y = pointset->y_coords[n];
+        packed[n].cluster = pointset->cluster_ids[n];
+    }
+}
+
+static void unpack_points(struct point *packed, int count, struct pointset *pointset)
+{
+    for (int n = 0; n < count; ++n) {
+        pointset->x_coords[n] = packed[n].x;
+        pointset->y_coords[n] = packed[n].y;
+        pointset->cluster_ids[n] = packed[n].cluster;
+    }
+}
+
+/**
+ * Scatter the points packed as an array of struct point, in one collective instead of one per array.
+ * The root packs the whole source and each node unpacks its own subset from the staging buffer.
+ */
+static void mpi_scatter_pointset_packed(struct pointset *source, struct pointset *target, int *counts, int *displacements)
+{
+    int count = target->num_points;
+    struct point *send_buffer = NULL;
+    if (mpi_rank == 0) {
+        // the root both sends the whole set and receives its own subset, so it needs both buffers
+        send_buffer = packed_buffer(&packed_main_points, &packed_main_capacity, source->num_points);
+        pack_points(source, source->num_points, send_buffer);
+    }
+    struct point *receive_buffer = packed_buffer(&packed_node_points, &packed_node_capacity, count);
+    MPI_Scatterv(send_buffer, counts, displacements, mpi_point_type(),
+                 receive_buffer, count, mpi_point_type(), 0, MPI_COMM_WORLD);
+    unpack_points(receive_buffer, count, target);
+}
+
+/**
+ * Gather the points packed as an array of struct point, in one collective instead of one per array.
+ */
+static void mpi_gather_pointset_packed(struct pointset *source, struct pointset *target, int *counts, int *displacements)
+{
+    int count = source->num_points;
+    struct point *receive_buffer = NULL;
+    if (mpi_rank == 0) {
+        receive_buffer = packed_buffer(&packed_main_points, &packed_main_capacity, target->num_points);
+    }
+    struct point *send_buffer = packed_buffer(&packed_node_points, &packed_node_capacity, count);
+    pack_points(source, count, send_buffer);
+    MPI_Gatherv(send_buffer, count, mpi_point_type(),
+                receive_buffer, counts, displacements, mpi_point_type(), 0, MPI_COMM_WORLD);
+    if (mpi_rank == 0) {
+        unpack_points(receive_buffer, target->num_points, target);
+    }
+}
+
+/**
+ * Distribute the source dataset on the root as subsets to all nodes - including the root.
+ * With --packed-transfer the points go in a single collective, otherwise in one per array.
+ *
+ * @param source full dataset (only used on root)
+ * @param target pre-allocated subset for this node
+ * @param counts number of points for each node
+ * @param displacements offset of the first point of each node in the source
+ */
+void mpi_scatter_pointset(struct pointset *source, struct pointset *target, int *counts, int *displacements)
+{
+    int count = target->num_points;
+    mpi_log(debug, "Starting %s scatter of %d points", kmeans_config->packed_transfer ? "packed" : "array", count);
+    if (kmeans_config->packed_transfer) {
+        mpi_scatter_pointset_packed(source, target, counts, displacements);
+        mpi_log(debug, "Scattered/Received %d packed points to/from other nodes", count);
+        return;
+    }
+    MPI_Scatterv(source->x_coords, counts, displacements, MPI_DOUBLE,
+                 target->x_coords, count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(source->y_coords, counts, displacements, MPI_DOUBLE,
+                 target->y_coords, count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(source->cluster_ids, counts, displacements, MPI_INT,
+                 target->cluster_ids, count, MPI_INT, 0, MPI_COMM_WORLD);
+    mpi_log(debug, "Scattered/Received %d points to/from other nodes", count);
+}
+
+/**
+ * Gather the subsets of points from all nodes (including the root) back into the target on the root.
+ *
+ * @param source subset of points on this node
+ * @param target full dataset (only used on root)
+ * @param counts number of points for each node
+ * @param displacements offset of the first point of each node in the target
+ */
+void mpi_gather_pointset(struct pointset *source, struct pointset *target, int *counts, int *displacements)
+{
+    int count = source->num_points;
+    mpi_log(debug, "Starting %s Gather of subset with %d points:", kmeans_config->packed_transfer ? "packed" : "array", count);
+    if (kmeans_config->packed_transfer) {
+        mpi_gather_pointset_packed(source, target, counts, displacements);
+        mpi_log(debug, "Done Gathering %d packed points", count);
+        return;
+    }
+    MPI_Gatherv(source->x_coords, count, MPI_DOUBLE,
+                target->x_coords, counts, displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(source->y_coords, count, MPI_DOUBLE,
+                target->y_coords, counts, displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    mpi_gather_cluster_ids(source, target, counts, displacements);
+}
+
+/**
+ * Gather only the cluster ids of the subsets of points from all nodes back into the target on the root.
+ * This is all that is needed when the coordinates on the root have not changed.
+ */
+void mpi_gather_cluster_ids(struct pointset *source, struct pointset *target, int *counts, int *displacements)
+{
+    int count = source->num_points;
+    MPI_Gatherv(source->cluster_ids, count, MPI_INT,
+                target->cluster_ids, counts, displacements, MPI_INT, 0, MPI_COMM_WORLD);
+    mpi_log(debug, "Done Gathering %d cluster ids", count);
+}
+
+/**
+ * Add a candidate centroid to the growing candidate arrays
+ */
+static void add_candidate(double **x_coords, double **y_coords, int *num_candidates, int *capacity,
+                          double x, double y)
+{
+    if (*num_candidates == *capacity) {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        *x_coords = (double *)realloc(*x_coords, *capacity * sizeof(double));
+        *y_coords = (double *)realloc(*y_coords, *capacity * sizeof(double));
+        if (*x_coords == NULL || *y_coords == NULL) {
+            FAIL("Failed to allocate %d k-means|| candidates", *capacity);
+        }
+    }
+    (*x_coords)[*num_candidates] = x;
+    (*y_coords)[*num_candidates] = y;
+    (*num_candidates)++;
+}
+
+/**
+ * Update the squared distance of every node point to its closest candidate with the
+ * candidates from first_candidate on, and return the sum over the node
+ */
+static double update_candidate_distances(struct pointset *node_dataset, double *distances,
+                                         double *x_coords, double *y_coords, int first_candidate, int num_candidates)
+{
+    double total = 0.0;
+    for (int n = 0; n < node_dataset->num_points; ++n) {
+        double closest = distances[n];
+        for (int c = first_candidate; c < num_candidates; ++c) {
+            double diff_x = x_coords[c] - node_dataset->x_coords[n];
+            double diff_y = y_coords[c] - node_dataset->y_coords[n];
+            double distance = diff_x * diff_x + diff_y * diff_y;
+            if (distance < closest) closest = distance;
+        }
+        distances[n] = closest;
+        total += closest;
+    }
+    return total;
+}
+
+/**
+ * Weighted squared distance of every candidate to its closest centroid, with the new centroid at
+ * (x, y) added to the closest distances so far
+ */
+static double weighted_potential(struct pointset *candidates, const double *weights, const double *closest,
+                                 double x, double y)
+{
+    double potential = 0.0;
+    for (int c = 0; c < candidates->num_points; ++c) {
+        double diff_x = x - candidates->x_coords[c];
+        double diff_y = y - candidates->y_coords[c];
+        double distance = diff_x * diff_x + diff_y * diff_y;
+        potential += weights[c] * (distance < closest[c] ? distance : closest[c]);
+    }
+    return potential;
+}
+
+/**
+ * Pick the candidate at a random fraction of the total weighted distance
+ */
+static int pick_weighted_candidate(struct pointset *candidates, const double *weights, const double *closest,
+                                   double total, uint64_t *random_state)
+{
+    double target = random_fraction(random_state) * total;
+    double sum = 0.0;
+    for (int c = 0; c < candidates->num_points; ++c) {
+        sum += weights[c] * closest[c];
+        if (sum > target) {
+            return c;
+        }
+    }
+    // rounding can leave the target beyond the last sum: take the last candidate with any weight
+    for (int c = candidates->num_points - 1; c > 0; --c) {
+        if (weights[c] * closest[c] > 0.0) {
+            return c;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reduce the weighted k-means|| candidates to the K centroids on the root.
+ *
+ * The centroids are chosen with greedy k-means++: each pick samples
+ * KMEANS_PARALLEL_TRIALS(K) candidates by weighted squared distance and keeps the one that
+ * leaves the lowest weighted cost. They are then refined with KMEANS_PARALLEL_LLOYD_ITERATIONS
+ * of weighted Lloyd over the candidates, which are few enough for this to be cheap.
+ */
+static void reduce_candidates(struct pointset *candidates, const double *weights, struct pointset *centroids,
+                              unsigned int seed)
+{
+    int num_candidates = candidates->num_points;
+    int num_clusters = centroids->num_points;
+    int trials = KMEANS_PARALLEL_TRIALS(num_clusters);
+    double *closest = (double *)malloc(num_candidates * sizeof(double));
+    int *nearest = (int *)malloc(num_candidates * sizeof(int));
+    double *sums = (double *)malloc(num_clusters * 3 * sizeof(double));
+    if (closest == NULL || nearest == NULL || sums == NULL) {
+        FAIL("Failed to allocate the reduction of %d k-means|| candidates", num_candidates);
+    }
+    uint64_t random_state = seed;
+
+    // the first centroid is chosen by weight alone
+    for (int c = 0; c < num_candidates; ++c) {
+        closest[c] = 1.0;
+    }
+    double total = 0.0;
+    for (int c = 0; c < num_candidates; ++c) {
+        total += weights[c];
+    }
+    int selected = pick_weighted_candidate(candidates, weights, closest, total, &random_state);
+    for (int k = 0; k < num_clusters; ++k) {
+        if (k > 0) {
+            // greedy k-means++: keep the best of several weighted picks
+            double best_potential = INFINITY;
+            for (int trial = 0; trial < trials; ++trial) {
+                int pick = pick_weighted_candidate(candidates, weights, closest, total, &random_state);
+                double potential = weighted_potential(candidates, weights, closest,
+                                                      candidates->x_coords[pick], candidates->y_coords[pick]);
+                if (potential < best_potential) {
+                    best_potential = potential;
+                    selected = pick;
+                }
+            }
+        }
+        double x = candidates->x_coords[selected];
+        double y = candidates->y_coords[selected];
+        set_point(centroids, k, x, y, IGNORE_CLUSTER_ID);
+        total = 0.0;
+        for (int c = 0; c < num_candidates; ++c) {
+            double diff_x = x - candidates->x_coords[c];
+            double diff_y = y - candidates->y_coords[c];
+            double distance = diff_x * diff_x + diff_y * diff_y;
+            if (k == 0 || distance < closest[c]) {
+                closest[c] = distance;
+                nearest[c] = k;
+            }
+            total += weights[c] * closest[c];
+        }
+    }
+
+    // weighted Lloyd over the candidates: a centroid with no candidates keeps its place
+    for (int iteration = 0; iteration < KMEANS_PARALLEL_LLOYD_ITERATIONS; ++iteration) {
+        for (int i = 0; i < num_clusters * 3; ++i) {
+            sums[i] = 0.0;
+        }
+        for (int c = 0; c < num_candidates; ++c) {
+            double min_distance = INFINITY;
+            for (int k = 0; k < num_clusters; ++k) {
+                double diff_x = centroids->x_coords[k] - candidates->x_coords[c];
+                double diff_y = centroids->y_coords[k] - candidates->y_coords[c];
+                double distance = diff_x * diff_x + diff_y * diff_y;
+                if (distance < min_distance) {
+                    min_distance = distance;
+                    nearest[c] = k;
+                }
+            }
+            sums[nearest[c] * 3] += weights[c] * candidates->x_coords[c];
+            sums[nearest[c] * 3 + 1] += weights[c] * candidates->y_coords[c];
+            sums[nearest[c] * 3 + 2] += weights[c];
+        }
+        for (int k = 0; k < num_clusters; ++k) {
+            if (sums[k * 3 + 2] > 0.0) {
+                set_point(centroids, k, sums[k * 3] / sums[k * 3 + 2], sums[k * 3 + 1] / sums[k * 3 + 2],
+                          IGNORE_CLUSTER_ID);
+            }
+        }
+    }
+
+    free(closest);
+    free(nearest);
+    free(sums);
+}
+
+/**
+ * Scalable k-means++ (k-means||, Bahmani et al.) initialization over the points resident on
+ * the nodes, so that the root does not need the whole dataset to choose the centroids.
+ *
+ * One point is chosen at random from the whole dataset, then in each of KMEANS_PARALLEL_ROUNDS
+ * rounds every node samples each of its points independently with probability
+ * KMEANS_PARALLEL_OVERSAMPLING * K * d^2 / (sum of d^2 over all nodes), where d is the distance
+ * to the closest candidate so far, and the new candidates are shared with every node.
+ * Each candidate is weighted by the number of points closest to it, and the root reduces the
+ * candidates to K centroids with greedy weighted k-means++ and a few weighted Lloyd iterations
+ * (see reduce_candidates). Extra rounds are run if there are fewer
+ * than K candidates. The centroids are only set on the root: broadcast them afterwards.
+ *
+ * @param node_dataset the points on this node
+ * @param counts number of points on each node
+ * @param displacements offset of the first point of each node in the whole dataset
+ * @param centroids centroids to be filled on the root: the number of points gives K
+ * @param seed seed for the random choices: the same seed and number of nodes give the same centroids
+ */
+void mpi_kmeans_parallel_centroids(struct pointset *node_dataset, int *counts, int *displacements,
+                                   struct pointset *centroids, unsigned int seed)
+{
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    int num_clusters = centroids->num_points;
+    int num_points = displacements[world_size - 1] + counts[world_size - 1];
+    double oversampling = KMEANS_PARALLEL_OVERSAMPLING * num_clusters;
+
+    // the first candidate: the same random choice on every node, sent by the node that has the point
+    uint64_t shared_random = seed;
+    int first_point = (int)(random_fraction(&shared_random) * num_points);
+    int owner = 0;
+    while (owner < world_size - 1 && first_point >= displacements[owner + 1]) owner++;
+    double first[2] = {0.0, 0.0};
+    if (mpi_rank == owner) {
+        first[0] = node_dataset->x_coords[first_point - displacements[owner]];
+        first[1] = node_dataset->y_coords[first_point - displacements[owner]];
+    }
+    MPI_Bcast(first, 2, MPI_DOUBLE, owner, MPI_COMM_WORLD);
+
+    double *x_coords = NULL;
+    double *y_coords = NULL;
+    int num_candidates = 0;
+    int capacity = 0;
+    add_candidate(&x_coords, &y_coords, &num_candidates, &capacity, first[0], first[1]);
+
+    double *distances = (double *)malloc((node_dataset->num_points + 1) * sizeof(double));
+    int *node_new_counts = (int *)malloc(world_size * sizeof(int));
+    int *node_new_displacements = (int *)malloc(world_size * sizeof(int));
+    if (distances == NULL || node_new_counts == NULL || node_new_displacements == NULL) {
+        FAIL("Failed to allocate k-means|| distances for %d points", node_dataset->num_points);
+    }
+    for (int n = 0; n < node_dataset->num_points; ++n) {
+        distances[n] = INFINITY;
+    }
+
+    // each node samples its points with its own random sequence
+    uint64_t node_random = seed + 0x9E3779B97F4A7C15ULL * (uint64_t)(mpi_rank + 1);
+    int max_rounds = KMEANS_PARALLEL_ROUNDS * 4;
+    int first_new = 0;
+    for (int round = 0; round < max_rounds; ++round) {
+        double node_cost = update_candidate_distances(node_dataset, distances, x_coords, y_coords,
+                                                      first_new, num_candidates);
+        double cost = 0.0;
+        MPI_Allreduce(&node_cost, &cost, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        if ((round >= KMEANS_PARALLEL_ROUNDS && num_candidates >= num_clusters) || cost <= 0.0) {
+            break;
+        }
+
+        // sample new candidates from this node, as x, y pairs
+        int node_new = 0;
+        int node_capacity = 0;
+        double *node_x = NULL;
+        double *node_y = NULL;
+        for (int n = 0; n < node_dataset->num_points; ++n) {
+            if (random_fraction(&node_random) < oversampling * distances[n] / cost) {
+                add_candidate(&node_x, &node_y, &node_new, &node_capacity,
+                              node_dataset->x_coords[n], node_dataset->y_coords[n]);
+            }
+        }
+        double *packed_new = (double *)malloc((2 * node_new + 1) * sizeof(double));
+        if (packed_new == NULL) {
+            FAIL("Failed to allocate %d new k-means|| candidates", node_new);
+        }
+        for (int c = 0; c < node_new; ++c) {
+            packed_new[2 * c] = node_x[c];
+            packed_new[2 * c + 1] = node_y[c];
+        }
+        free(node_x);
+        free(node_y);
+
+        // share the new candidates of every node with every node
+        int pair_count = 2 * node_new;
+        MPI_Allgather(&pair_count, 1, MPI_INT, node_new_counts, 1, MPI_INT, MPI_COMM_WORLD);
+        int total_new = 0;
+        for (int r = 0; r < world_size; ++r) {
+            node_new_displacements[r] = total_new;
+            total_new += node_new_counts[r];
+        }
+        double *all_new = (double *)malloc((total_new + 1) * sizeof(double));
+        if (all_new == NULL) {
+            FAIL("Failed to allocate %d k-means|| candidates", total_new / 2);
+        }
+        MPI_Allgatherv(packed_new, pair_count, MPI_DOUBLE, all_new, node_new_counts, node_new_displacements,
+                       MPI_DOUBLE, MPI_COMM_WORLD);
+        free(packed_new);
+        first_new = num_candidates;
+        for (int c = 0; c < total_new / 2; ++c) {
+            add_candidate(&x_coords, &y_coords, &num_candidates, &capacity, all_new[2 * c], all_new[2 * c + 1]);
+        }
+        free(all_new);
+        mpi_log(debug, "k-means|| round %d: cost %f, %d candidates", round, cost, num_candidates);
+    }
+    if (num_candidates < num_clusters) {
+        FAIL("k-means|| found only %d candidates for %d clusters", num_candidates, num_clusters);
+    }
+
+    // weight each candidate by the number of points closest to it, over all nodes
+    double *node_weights = (double *)calloc(num_candidates, sizeof(double));
+    double *weights = (double *)calloc(num_candidates, sizeof(double));
+    if (node_weights == NULL || weights == NULL) {
+        FAIL("Failed to allocate k-means|| weights for %d candidates", num_candidates);
+    }
+    for (int n = 0; n < node_dataset->num_points; ++n) {
+        double min_distance = INFINITY;
+        int closest = 0;
+        for (int c = 0; c < num_candidates; ++c) {
+            double diff_x = x_coords[c] - node_dataset->x_coords[n];
+            double diff_y = y_coords[c] - node_dataset->y_coords[n];
+            double distance = diff_x * diff_x + diff_y * diff_y;
+            if (distance < min_distance) {
+                min_distance = distance;
+                closest = c;
+            }
+        }
+        node_weights[closest] += 1.0;
+    }
+    MPI_Reduce(node_weights, weights, num_candidates, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (mpi_rank == 0) {
+        struct pointset candidates;
+        candidates.num_points = num_candidates;
+        candidates.x_coords = x_coords;
+        candidates.y_coords = y_coords;
+        candidates.cluster_ids = NULL;
+        reduce_candidates(&candidates, weights, centroids, seed);
+        mpi_log(info, "k-means|| chose %d centroids from %d weighted candidates", num_clusters, num_candidates);
+    }
+
+    free(x_coords);
+    free(y_coords);
+    free(distances);
+    free(node_new_counts);
+    free(node_new_displacements);
+    free(node_weights);
+    free(weights);
+}
+
+/**
+ * Read size bytes at offset in the file into buffer on every node, collectively.
+ * The size may differ between nodes (and be zero), and large sizes are read in pieces of
+ * MPI_IO_MAX_BYTES bytes since the MPI counts are ints.
+ */
+static void mpi_read_at_all(MPI_File file, char *file_name, MPI_Offset offset, void *buffer, MPI_Offset size)
+{
+    long long pieces = (size + MPI_IO_MAX_BYTES - 1) / MPI_IO_MAX_BYTES;
+    long long max_pieces;
+    MPI_Allreduce(&pieces, &max_pieces, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    char *p = (char *)buffer;
+    for (long long piece = 0; piece < max_pieces; ++piece) {
+        int bytes = size > MPI_IO_MAX_BYTES ? MPI_IO_MAX_BYTES : (int)size;
+        MPI_Status status;
+        int bytes_read = 0;
+        if (MPI_File_read_at_all(file, offset, p, bytes, MPI_BYTE, &status) == MPI_SUCCESS) {
+            MPI_Get_count(&status, MPI_BYTE, &bytes_read);
+        }
+        if (bytes_read != bytes) {
+            FAIL("Cannot read %d bytes at %lld from the input file %s", bytes, (long long)offset, file_name);
+        }
+        p += bytes;
+        offset += bytes;
+        size -= bytes;
+    }
+}
+
+/**
+ * Find the start of the first line after offset: just after the first \n at or after offset
+ *
+ * @return offset of the start of the line or the file size if there is none
+ */
+static MPI_Offset mpi_find_line_start(MPI_File file, char *file_name, MPI_Offset offset, MPI_Offset file_size)
+{
+    char block[MPI_IO_LINE_BLOCK];
+    while (offset < file_size) {
+        int bytes = file_size - offset < MPI_IO_LINE_BLOCK ? (int)(file_size - offset) : MPI_IO_LINE_BLOCK;
+        MPI_Status status;
+        if (MPI_File_read_at(file, offset, block, bytes, MPI_BYTE, &status) != MPI_SUCCESS) {
+            FAIL("Cannot read %d bytes at %lld from the input file %s", bytes, (long long)offset, file_name);
+        }
+        char *newline = (char *)memchr(block, '\n', bytes);
+        if (newline != NULL) {
+            return offset + (newline - block) + 1;
+        }
+        offset += bytes;
+    }
+    return file_size;
+}
+
+/**
+ * Read this node's part of a binary points file: the same split of the points as
+ * mpi_partition_points, read from the x, y and cluster arrays of the file at its offsets
+ */
+static int mpi_read_points_file(MPI_File file, char *file_name, struct points_file_header *header, int max_points,
+                                struct pointset *node_dataset, int *counts, int *displacements)
+{
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    int num_points = header->num_points < (uint64_t)max_points ? (int)header->num_points : max_points;
+    mpi_partition_points(num_points, world_size, counts, displacements);
+    int count = counts[mpi_rank];
+    mpi_allocate_node_pointset(node_dataset, count);
+
+    MPI_Offset first = (MPI_Offset)displacements[mpi_rank];
+    MPI_Offset x_offset = sizeof(struct points_file_header);
+    MPI_Offset y_offset = x_offset + (MPI_Offset)(header->num_points * sizeof(double));
+    MPI_Offset clusters_offset = y_offset + (MPI_Offset)(header->num_points * sizeof(double));
+    mpi_read_at_all(file, file_name, x_offset + first * sizeof(double), node_dataset->x_coords,
+                    count * sizeof(double));
+    mpi_read_at_all(file, file_name, y_offset + first * sizeof(double), node_dataset->y_coords,
+                    count * sizeof(double));
+    if (header->has_clusters) {
+        if (sizeof(int) != sizeof(int32_t)) {
+            FAIL("Reading the cluster ids of %s with MPI-IO needs 32-bit ints", file_name);
+        }
+        mpi_read_at_all(file, file_name, clusters_offset + first * sizeof(int32_t), node_dataset->cluster_ids,
+                        count * sizeof(int32_t));
+    }
+    else {
+        for (int n = 0; n < count; ++n) {
+            node_dataset->cluster_ids[n] = NO_CLUSTER_ID;
+        }
+    }
+    return num_points;
+}
+
+/**
+ * Read this node's part of a csv file.
+ *
+ * The body of the file after the headers is split into equal byte ranges, one per node, each
+ * moved to start at the beginning of a line, so every line belongs to exactly one node. Each
+ * node reads its range, counts the lines and takes the index of its first point from a prefix
+ * sum over the nodes, which gives its share of max_points. As with the other readers the
+ * points stop at the first line with fewer than two fields, wherever in the file that is.
+ */
+static int mpi_read_csv_file(MPI_File file, char *file_name, int max_points, struct pointset *node_dataset,
+                             int *counts, int *displacements, char *headers[], int *dimensions)
+{
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Offset file_size;
+    MPI_File_get_size(file, &file_size);
+
+    // the root reads the headers and tells every node where the points start
+    long long body_offset = 0;
+    if (mpi_rank == 0) {
+        body_offset = mpi_find_line_start(file, file_name, 0, file_size);
+        *dimensions = 0;
+        if (body_offset > 0) {
+            char *header_line = (char *)malloc(body_offset);
+            MPI_Status status;
+            MPI_File_read_at(file, 0, header_line, (int)body_offset, MPI_BYTE, &status);
+            const char *body;
+            *dimensions = parse_csv_headers(header_line, header_line + body_offset, headers, &body);
+            free(header_line);
+        }
+    }
+    MPI_Bcast(&body_offset, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    MPI_Bcast(dimensions, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    MPI_Offset body_size = file_size - body_offset;
+    MPI_Offset range_start = body_offset;
+    if (mpi_rank > 0) {
+        // a line starts at the nominal start if the byte before it is a \n
+        MPI_Offset nominal_start = body_offset + body_size / world_size * mpi_rank;
+        range_start = nominal_start > 0 ? mpi_find_line_start(file, file_name, nominal_start - 1, file_size) : 0;
+    }
+    long long start = range_start;
+    long long *starts = (long long *)malloc(world_size * sizeof(long long));
+    MPI_Allgather(&start, 1, MPI_LONG_LONG, starts, 1, MPI_LONG_LONG, MPI_COMM_WORLD);
+    MPI_Offset range_stop = mpi_rank + 1 < world_size ? starts[mpi_rank + 1] : file_size;
+    free(starts);
+    MPI_Offset range_size = range_stop - range_start;
+
+    char *text = (char *)malloc(range_size > 0 ? range_size : 1);
+    if (text == NULL) {
+        FAIL("Failed to allocate %lld bytes for the input of node %d", (long long)range_size, mpi_rank);
+    }
+    mpi_read_at_all(file, file_name, range_start, text, range_size);
+
+    int lines = count_csv_lines(text, text + range_size);
+    int first_line = 0;
+    MPI_Exscan(&lines, &first_line, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (mpi_rank == 0) {
+        first_line = 0; // the exclusive scan leaves the first node's result undefined
+    }
+    int node_max = max_points - first_line;
+    node_max = node_max < 0 ? 0 : (node_max > lines ? lines : node_max);
+    mpi_allocate_node_pointset(node_dataset, node_max);
+    int parsed = node_max > 0 ? parse_csv_lines(text, text + range_size, node_dataset, node_max, *dimensions > 2) : 0;
+    free(text);
+
+    // drop the points after the first bad line in the whole file
+    int bad_line = parsed < node_max ? first_line + parsed : INT_MAX;
+    int first_bad_line;
+    MPI_Allreduce(&bad_line, &first_bad_line, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    int count = parsed;
+    if (first_bad_line < first_line + parsed) {
+        count = first_bad_line > first_line ? first_bad_line - first_line : 0;
+    }
+    node_dataset->num_points = count;
+
+    MPI_Allgather(&count, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+    int num_points = 0;
+    for (int rank = 0; rank < world_size; ++rank) {
+        displacements[rank] = num_points;
+        num_points += counts[rank];
+    }
+    return num_points;
+}
+
+/**
+ * Read the part of the input file for this node straight into the node dataset with MPI-IO,
+ * so that all the nodes read in parallel and no node ever holds the whole dataset.
+ * The input is a binary points file or a csv file, as for load_dataset().
+ *
+ * @param file_name path to the input file, which every node must be able to read
+ * @param max_points max number of points to read over all the nodes
+ * @param node_dataset unallocated subset of points for this node
+ * @param counts pre-allocated array to be filled with the number of points read by each node
+ * @param displacements pre-allocated array to be filled with the index of the first point of each node
+ * @param headers pre-allocated string array to hold the headers (filled on root only)
+ * @param dimensions number of headers
+ *
+ * @return the total number of points read by all the nodes
+ */
+int mpi_read_node_pointset(char *file_name, int max_points, struct pointset *node_dataset, int *counts,
+                           int *displacements, char *headers[], int *dimensions)
+{
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, file_name, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        FAIL("Cannot read the input file at %s with MPI-IO", file_name);
+    }
+
+    // the root looks for the header of a binary points file and shares it
+    struct points_file_header header;
+    int is_binary = 0;
+    if (mpi_rank == 0) {
+        MPI_Status status;
+        int bytes_read = 0;
+        memset(&header, 0, sizeof(header));
+        if (MPI_File_read_at(file, 0, &header, sizeof(header), MPI_BYTE, &status) == MPI_SUCCESS) {
+            MPI_Get_count(&status, MPI_BYTE, &bytes_read);
+        }
+        is_binary = bytes_read == (int)sizeof(header) &&
+                    memcmp(header.magic, POINTS_FILE_MAGIC, POINTS_FILE_MAGIC_LENGTH) == 0;
+    }
+    MPI_Bcast(&is_binary, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    int num_points;
+    if (is_binary) {
+        MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, MPI_COMM_WORLD);
+        *dimensions = check_points_file_header(&header, file_name, mpi_rank == 0 ? headers : NULL);
+        num_points = mpi_read_points_file(file, file_name, &header, max_points, node_dataset, counts, displacements);
+    }
+    else {
+        num_points = mpi_read_csv_file(file, file_name, max_points, node_dataset, counts, displacements,
+                                       headers, dimensions);
+    }
+    MPI_File_close(&file);
+    mpi_log(debug, "Read %d of %d points with MPI-IO", node_dataset->num_points, num_points);
+    return num_points;
+}
+
+/**
+ * Write the text of every node to the file, in the order of the node ranks, with MPI-IO.
+ *
+ * The offset of each node's text is the total size of the text of the nodes before it (an
+ * exclusive prefix sum), so all the nodes write their parts at once with MPI_File_write_at_all
+ * and no node ever holds more than its own part. Any existing file is replaced.
+ *
+ * @param file_name path to the output file
+ * @param text the text of this node (may be empty)
+ * @param size number of bytes of text
+ */
+void mpi_write_ordered(char *file_name, char *text, long long size)
+{
+    long long offset = 0;
+    long long total_size = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (mpi_rank == 0) {
+        offset = 0; // the exclusive scan leaves the first node's result undefined
+    }
+    MPI_Allreduce(&size, &total_size, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, file_name, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS) {
+        FAIL("Cannot write to the output file at %s with MPI-IO", file_name);
+    }
+    // cut off the end of any longer file that was there before
+    MPI_File_set_size(file, (MPI_Offset)total_size);
+
+    mpi_log(debug, "Writing %lld bytes at %lld of %lld with MPI-IO", size, offset, total_size);
+    long long pieces = (size + MPI_IO_MAX_BYTES - 1) / MPI_IO_MAX_BYTES;
+    long long max_pieces;
+    MPI_Allreduce(&pieces, &max_pieces, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    for (long long piece = 0; piece < max_pieces; ++piece) {
+        int bytes = size > MPI_IO_MAX_BYTES ? MPI_IO_MAX_BYTES : (int)size;
+        MPI_Status status;
+        int bytes_written = 0;
+        if (MPI_File_write_at_all(file, (MPI_Offset)offset, text, bytes, MPI_BYTE, &status) == MPI_SUCCESS) {
+            MPI_Get_count(&status, MPI_BYTE, &bytes_written);
+        }
+        if (bytes_written != bytes) {
+            FAIL("Cannot write %d bytes at %lld to the output file %s", bytes, offset, file_name);
+        }
+        text += bytes;
+        offset += bytes;
+        size -= bytes;
+    }
+    MPI_File_close(&file);
+}
@@ -0,0 +1,25 @@
+#ifndef KMEANS_MPI_SUPPORT_H
+#define KMEANS_MPI_SUPPORT_H
+
+#include "kmeans.h"
+
+// k-means|| initialization: sampling rounds and the expected candidates per round as a multiple of K
+#define KMEANS_PARALLEL_ROUNDS 8
+#define KMEANS_PARALLEL_OVERSAMPLING 2
+// candidates tried for each greedy k-means++ pick when reducing the candidates, as in scikit-learn
+#define KMEANS_PARALLEL_TRIALS(k) (2 + (int)log(k))
+// weighted Lloyd iterations over the candidates after the greedy picks
+#define KMEANS_PARALLEL_LLOYD_ITERATIONS 10
+
+extern void mpi_partition_points(int num_points, int world_size, int *counts, int *displacements);
+extern void mpi_allocate_node_pointset(struct pointset *node_dataset, int num_points);
+extern int mpi_read_node_pointset(char *file_name, int max_points, struct pointset *node_dataset, int *counts,
+                                  int *displacements, char *headers[], int *dimensions);
+extern void mpi_write_ordered(char *file_name, char *text, long long size);
+extern void mpi_scatter_pointset(struct pointset *source, struct pointset *target, int *counts, int *displacements);
+extern void mpi_gather_pointset(struct pointset *source, struct pointset *target, int *counts, int *displacements);
+extern void mpi_gather_cluster_ids(struct pointset *source, struct pointset *target, int *counts, int *displacements);
+extern void mpi_kmeans_parallel_centroids(struct pointset *node_dataset, int *counts, int *displacements,
+                                          struct pointset *centroids, unsigned int seed);
+
+#endif
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "kmeans.h"
 #include "kmeans_support.h"
+#include "kmeans_sequential.h"
 #include "log.h"
 #include <float.h>
 
@@ -49,6 +51,55 @@ void simple_calculate_centroids(struct pointset *dataset, struct pointset *centr
 }
 
 
+/**
+ * Accumulate the per-cluster sums of x and y coordinates and the count of points in each
+ * cluster of the dataset, without calculating the means.
+ *
+ * The sums are packed into a single buffer of num_clusters * CLUSTER_SUMS_STRIDE doubles
+ * ([sum_x, sum_y, count] for each cluster) so that partial sums from different subsets of
+ * the data can be combined with a single reduction before the centroids are updated.
+ *
+ * @param dataset dataset (or subset) of points with current cluster assignments
+ * @param cluster_sums buffer of num_clusters * CLUSTER_SUMS_STRIDE doubles to be filled
+ * @param num_clusters number of clusters
+ */
+void simple_accumulate_clusters(struct pointset *dataset, double *cluster_sums, int num_clusters)
+{
+    int num_points = dataset->num_points;
+    for (int i = 0; i < num_clusters * CLUSTER_SUMS_STRIDE; ++i) {
+        cluster_sums[i] = 0.0;
+    }
+
+    for (int n = 0; n < num_points; ++n) {
+        double *sums = cluster_sums + dataset->cluster_ids[n] * CLUSTER_SUMS_STRIDE;
+        sums[0] += dataset->x_coords[n];
+        sums[1] += dataset->y_coords[n];
+        sums[2] += 1.0;
+    }
+}
+
+/**
+ * Update the centroids to the means of the clusters from packed per-cluster sums
+ * as produced by simple_accumulate_clusters (possibly reduced across several nodes).
+ *
+ * @param cluster_sums buffer of [sum_x, sum_y, count] for each centroid
+ * @param centroids centroids to be updated
+ */
+void simple_update_centroids(double *cluster_sums, struct pointset *centroids)
+{
+    int num_clusters = centroids->num_points;
+    for (int k = 0; k < num_clusters; ++k) {
+        double *sums = cluster_sums + k * CLUSTER_SUMS_STRIDE;
+        double cluster_size = sums[2];
+        TRACE("Cluster %d has %.0f points", k, cluster_size);
+        // ignore empty clusters (otherwise div by zero!)
+        if (cluster_size > 0) {
+            set_point(centroids, k, sums[0] / cluster_size, sums[1] / cluster_size, IGNORE_CLUSTER_ID);
+        }
+    }
+}
+
+
 /**
  * Assigns each point in the dataset to a cluster based on the distance from that cluster.
  *
@@ -91,8 +142,542 @@ int simple_assign_clusters(struct pointset *dataset, struct pointset *centroids)
     return cluster_changes;
 }
 
+/**
+ * Assigns each point in the dataset to a cluster AND accumulates the per-cluster sums of the
+ * new clusters, in a single pass over the data.
+ *
+ * This combines simple_assign_clusters with simple_accumulate_clusters: each point is added
+ * to the sums of its new cluster while it is still in cache from the distance calculations,
+ * so the coordinates are only read once per iteration, and the centroid step is reduced to
+ * the O(K) simple_update_centroids.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @param cluster_sums buffer of num_clusters * CLUSTER_SUMS_STRIDE doubles to be filled
+ * @return the number of points for which the cluster assignment was changed
+ */
+int simple_assign_accumulate_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums)
+{
+    TRACE("Starting single pass assignment");
+    int cluster_changes = 0;
+
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    for (int i = 0; i < num_clusters * CLUSTER_SUMS_STRIDE; ++i) {
+        cluster_sums[i] = 0.0;
+    }
+
+    for (int n = 0; n < num_points; ++n) {
+        double min_distance = DBL_MAX;
+        int closest_cluster = -1;
+        for (int k = 0; k < num_clusters; ++k) {
+            double distance_from_centroid = point_distance(dataset, n, centroids, k);
+            if (distance_from_centroid < min_distance) {
+                min_distance = distance_from_centroid;
+                closest_cluster = k;
+            }
+        }
+        if (dataset->cluster_ids[n] != closest_cluster) {
+            dataset->cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+        }
+        double *sums = cluster_sums + closest_cluster * CLUSTER_SUMS_STRIDE;
+        sums[0] += dataset->x_coords[n];
+        sums[1] += dataset->y_coords[n];
+        sums[2] += 1.0;
+    }
+    TRACE("Leaving single pass assignment with %d cluster changes", cluster_changes);
+    return cluster_changes;
+}
 
 
+/**
+ * Assigns each point in the dataset to a cluster AND moves each point that changes cluster
+ * from the sums of its old cluster to the sums of its new one.
+ *
+ * The cluster_sums persist between iterations, so once few points change cluster the centroid
+ * step costs O(changes + K) rather than O(N). The sums must already hold the sums of the current
+ * clusters (e.g. from simple_assign_accumulate_clusters) and should be recomputed from scratch
+ * every INCREMENTAL_REFRESH_ITERATIONS to keep the floating point error of the updates bounded.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @param cluster_sums num_clusters * CLUSTER_SUMS_STRIDE sums of the current clusters, to be updated
+ * @return the number of points for which the cluster assignment was changed
+ */
+int simple_assign_move_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums)
+{
+    TRACE("Starting incremental assignment");
+    int cluster_changes = 0;
+
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    for (int n = 0; n < num_points; ++n) {
+        double min_distance = DBL_MAX;
+        int closest_cluster = -1;
+        for (int k = 0; k < num_clusters; ++k) {
+            double distance_from_centroid = point_distance(dataset, n, centroids, k);
+            if (distance_from_centroid < min_distance) {
+                min_distance = distance_from_centroid;
+                closest_cluster = k;
+            }
+        }
+        int old_cluster = dataset->cluster_ids[n];
+        if (old_cluster != closest_cluster) {
+            dataset->cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+            double *old_sums = cluster_sums + old_cluster * CLUSTER_SUMS_STRIDE;
+            old_sums[0] -= dataset->x_coords[n];
+            old_sums[1] -= dataset->y_coords[n];
+            old_sums[2] -= 1.0;
+            double *new_sums = cluster_sums + closest_cluster * CLUSTER_SUMS_STRIDE;
+            new_sums[0] += dataset->x_coords[n];
+            new_sums[1] += dataset->y_coords[n];
+            new_sums[2] += 1.0;
+        }
+    }
+    TRACE("Leaving incremental assignment with %d cluster changes", cluster_changes);
+    return cluster_changes;
+}
+
+
+/**
+ * OpenMP parallel version of simple_assign_clusters: the points are split statically
+ * over the threads and the change counts of the threads are combined with a reduction.
+ *
+ * Each point is only written by the thread that owns it, so apart from the final
+ * reduction the threads do not need to synchronize.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @return the number of points for which the cluster assignment was changed
+ */
+int omp_assign_clusters(struct pointset *dataset, struct pointset *centroids)
+{
+    TRACE("Starting omp assignment");
+    int cluster_changes = 0;
+
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    #pragma omp parallel for schedule(static) reduction(+:cluster_changes)
+    for (int n = 0; n < num_points; ++n) {
+        double min_distance = DBL_MAX; // init the min distance to a big number
+        int closest_cluster = -1;
+        for (int k = 0; k < num_clusters; ++k) {
+            double distance_from_centroid = point_distance(dataset, n, centroids, k);
+            if (distance_from_centroid < min_distance) {
+                min_distance = distance_from_centroid;
+                closest_cluster = k;
+            }
+        }
+        // if the point was not already in the closest cluster, move it there and count changes
+        if (dataset->cluster_ids[n] != closest_cluster) {
+            dataset->cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+        }
+    }
+    TRACE("Leaving omp assignment with %d cluster changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Sum of the squared distances from every point to the centroid of its cluster: the k-means
+ * objective, to compare the quality of the clustering between engines
+ *
+ * @param dataset set of all points with their final cluster assignments
+ * @param centroids set of final centroids
+ * @return the inertia of the clustering
+ */
+double cluster_inertia(struct pointset *dataset, struct pointset *centroids)
+{
+    double inertia = 0.0;
+    int num_points = dataset->num_points;
+    #pragma omp parallel for schedule(static) reduction(+:inertia)
+    for (int n = 0; n < num_points; ++n) {
+        int k = dataset->cluster_ids[n];
+        double diff_x = centroids->x_coords[k] - dataset->x_coords[n];
+        double diff_y = centroids->y_coords[k] - dataset->y_coords[n];
+        inertia += diff_x * diff_x + diff_y * diff_y;
+    }
+    return inertia;
+}
+
+// per-thread accumulators for omp_accumulate_clusters, grown as needed and reused between iterations
+static double *thread_sums_memory = NULL;
+static size_t thread_sums_capacity = 0;
+
+/**
+ * Allocate space for one block of accumulators per thread, with each block aligned to and
+ * padded out to whole cache lines so that no two threads ever write to the same cache line.
+ *
+ * @return the first block, aligned to a cache line
+ */
+static double *thread_sums_buffer(int num_threads, int block_size)
+{
+    size_t needed = (size_t)num_threads * block_size + DOUBLES_PER_CACHE_LINE;
+    if (needed > thread_sums_capacity) {
+        free(thread_sums_memory);
+        thread_sums_memory = (double *)malloc(needed * sizeof(double));
+        if (thread_sums_memory == NULL) {
+            FAIL("Failed to allocate per-thread cluster sums for %d threads", num_threads);
+        }
+        thread_sums_capacity = needed;
+    }
+    // skip forward to the first cache line boundary
+    size_t misalignment = ((size_t)thread_sums_memory) % (DOUBLES_PER_CACHE_LINE * sizeof(double));
+    size_t skip = misalignment == 0 ? 0 : (DOUBLES_PER_CACHE_LINE * sizeof(double) - misalignment) / sizeof(double);
+    return thread_sums_memory + skip;
+}
+
+/**
+ * Size of the block of sums for each thread: rounded up to whole cache lines
+ */
+static int thread_sums_block_size(int num_sums)
+{
+    return (num_sums + DOUBLES_PER_CACHE_LINE - 1) / DOUBLES_PER_CACHE_LINE * DOUBLES_PER_CACHE_LINE;
+}
+
+/**
+ * Merge the private blocks of sums of all threads into the first block, pairwise in a tree:
+ * at each step the threads at multiples of 2 * step absorb the block step away.
+ * Must be called by every thread of the enclosing parallel region once its own sums are complete.
+ */
+static void tree_reduce_thread_sums(double *thread_sums, int block_size, int num_sums)
+{
+    int num_threads = omp_get_num_threads();
+    int thread = omp_get_thread_num();
+    double *sums = thread_sums + thread * block_size;
+    for (int step = 1; step < num_threads; step *= 2) {
+        if (thread % (2 * step) == 0 && thread + step < num_threads) {
+            double *other = thread_sums + (thread + step) * block_size;
+            for (int i = 0; i < num_sums; ++i) {
+                sums[i] += other[i];
+            }
+        }
+        #pragma omp barrier
+    }
+}
+
+/**
+ * OpenMP parallel version of simple_accumulate_clusters.
+ *
+ * Every thread accumulates the sums for its share of the points into its own private block
+ * of per-cluster sums, padded to whole cache lines to avoid false sharing. The blocks are then
+ * merged pairwise in a tree reduction (log2 of the number of threads steps) and the result
+ * of the first block is copied to the packed cluster_sums buffer.
+ *
+ * @param dataset dataset (or subset) of points with current cluster assignments
+ * @param cluster_sums buffer of num_clusters * CLUSTER_SUMS_STRIDE doubles to be filled
+ * @param num_clusters number of clusters
+ */
+void omp_accumulate_clusters(struct pointset *dataset, double *cluster_sums, int num_clusters)
+{
+    int num_points = dataset->num_points;
+    int num_sums = num_clusters * CLUSTER_SUMS_STRIDE;
+    int block_size = thread_sums_block_size(num_sums);
+    double *thread_sums = thread_sums_buffer(omp_get_max_threads(), block_size);
+
+    #pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        double *sums = thread_sums + thread * block_size;
+        for (int i = 0; i < num_sums; ++i) {
+            sums[i] = 0.0;
+        }
+
+        #pragma omp for schedule(static)
+        for (int n = 0; n < num_points; ++n) {
+            double *cluster = sums + dataset->cluster_ids[n] * CLUSTER_SUMS_STRIDE;
+            cluster[0] += dataset->x_coords[n];
+            cluster[1] += dataset->y_coords[n];
+            cluster[2] += 1.0;
+        }
+        // implicit barrier at the end of the omp for: all private sums are complete
+        tree_reduce_thread_sums(thread_sums, block_size, num_sums);
+    }
+
+    for (int i = 0; i < num_sums; ++i) {
+        cluster_sums[i] = thread_sums[i];
+    }
+}
+
+/**
+ * OpenMP parallel re-calculation of centroids: thread-parallel accumulation of the
+ * per-cluster sums followed by the (O(K)) update of the centroids to the means.
+ *
+ * @param dataset dataset of points
+ * @param centroids centroids to be updated
+ */
+void omp_calculate_centroids(struct pointset *dataset, struct pointset *centroids)
+{
+    int num_clusters = centroids->num_points;
+    double cluster_sums[num_clusters * CLUSTER_SUMS_STRIDE];
+    omp_accumulate_clusters(dataset, cluster_sums, num_clusters);
+    simple_update_centroids(cluster_sums, centroids);
+}
+
+/**
+ * OpenMP parallel version of simple_assign_accumulate_clusters: each thread assigns its share
+ * of the points and adds them to its own private (cache line padded) block of cluster sums,
+ * then the blocks are merged in a tree reduction.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @param cluster_sums buffer of num_clusters * CLUSTER_SUMS_STRIDE doubles to be filled
+ * @return the number of points for which the cluster assignment was changed
+ */
+int omp_assign_accumulate_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums)
+{
+    int cluster_changes = 0;
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    int num_sums = num_clusters * CLUSTER_SUMS_STRIDE;
+    int block_size = thread_sums_block_size(num_sums);
+    double *thread_sums = thread_sums_buffer(omp_get_max_threads(), block_size);
+
+    #pragma omp parallel reduction(+:cluster_changes)
+    {
+        int thread = omp_get_thread_num();
+        double *sums = thread_sums + thread * block_size;
+        for (int i = 0; i < num_sums; ++i) {
+            sums[i] = 0.0;
+        }
+
+        #pragma omp for schedule(static)
+        for (int n = 0; n < num_points; ++n) {
+            double min_distance = DBL_MAX;
+            int closest_cluster = -1;
+            for (int k = 0; k < num_clusters; ++k) {
+                double distance_from_centroid = point_distance(dataset, n, centroids, k);
+                if (distance_from_centroid < min_distance) {
+                    min_distance = distance_from_centroid;
+                    closest_cluster = k;
+                }
+            }
+            if (dataset->cluster_ids[n] != closest_cluster) {
+                dataset->cluster_ids[n] = closest_cluster;
+                cluster_changes++;
+            }
+            double *cluster = sums + closest_cluster * CLUSTER_SUMS_STRIDE;
+            cluster[0] += dataset->x_coords[n];
+            cluster[1] += dataset->y_coords[n];
+            cluster[2] += 1.0;
+        }
+        tree_reduce_thread_sums(thread_sums, block_size, num_sums);
+    }
+
+    for (int i = 0; i < num_sums; ++i) {
+        cluster_sums[i] = thread_sums[i];
+    }
+    return cluster_changes;
+}
+
+/**
+ * OpenMP parallel version of simple_assign_move_clusters: each thread collects the changes to
+ * the sums made by moving its share of the points in its own private (cache line padded) block,
+ * then the blocks are merged in a tree reduction and added to the persistent cluster_sums.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @param cluster_sums num_clusters * CLUSTER_SUMS_STRIDE sums of the current clusters, to be updated
+ * @return the number of points for which the cluster assignment was changed
+ */
+int omp_assign_move_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums)
+{
+    int cluster_changes = 0;
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    int num_sums = num_clusters * CLUSTER_SUMS_STRIDE;
+    int block_size = thread_sums_block_size(num_sums);
+    double *thread_sums = thread_sums_buffer(omp_get_max_threads(), block_size);
+
+    #pragma omp parallel reduction(+:cluster_changes)
+    {
+        int thread = omp_get_thread_num();
+        double *moves = thread_sums + thread * block_size;
+        for (int i = 0; i < num_sums; ++i) {
+            moves[i] = 0.0;
+        }
+
+        #pragma omp for schedule(static)
+        for (int n = 0; n < num_points; ++n) {
+            double min_distance = DBL_MAX;
+            int closest_cluster = -1;
+            for (int k = 0; k < num_clusters; ++k) {
+                double distance_from_centroid = point_distance(dataset, n, centroids, k);
+                if (distance_from_centroid < min_distance) {
+                    min_distance = distance_from_centroid;
+                    closest_cluster = k;
+                }
+            }
+            int old_cluster = dataset->cluster_ids[n];
+            if (old_cluster != closest_cluster) {
+                dataset->cluster_ids[n] = closest_cluster;
+                cluster_changes++;
+                double *old_moves = moves + old_cluster * CLUSTER_SUMS_STRIDE;
+                old_moves[0] -= dataset->x_coords[n];
+                old_moves[1] -= dataset->y_coords[n];
+                old_moves[2] -= 1.0;
+                double *new_moves = moves + closest_cluster * CLUSTER_SUMS_STRIDE;
+                new_moves[0] += dataset->x_coords[n];
+                new_moves[1] += dataset->y_coords[n];
+                new_moves[2] += 1.0;
+            }
+        }
+        tree_reduce_thread_sums(thread_sums, block_size, num_sums);
+    }
+
+    for (int i = 0; i < num_sums; ++i) {
+        cluster_sums[i] += thread_sums[i];
+    }
+    return cluster_changes;
+}
+
+/**
+ * Set the number of OpenMP threads for the threaded kernels from the configuration.
+ *
+ * @param num_threads requested number of threads, or 0 to keep the OpenMP default (OMP_NUM_THREADS)
+ * @return the number of threads that parallel regions will use
+ */
+int omp_configure_threads(int num_threads)
+{
+    if (num_threads > 0) {
+        omp_set_num_threads(num_threads);
+    }
+    return omp_get_max_threads();
+}
+
+
+/**
+ * splitmix64 pseudo random numbers: the same sequence for the same seed on every platform
+ * and C library (unlike rand), so seeded initializations are reproducible between machines.
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Uniform pseudo random number in [0, 1)
+ */
+double random_fraction(uint64_t *state)
+{
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Pick a point at random with probability proportional to its weighted distance from the
+ * chosen centroids, using the per-block totals to skip straight to the right block.
+ */
+static int select_weighted_point(double *distances, const double *weights, double *block_totals,
+                                 int num_points, int num_blocks, uint64_t *random_state)
+{
+    double total = 0.0;
+    for (int b = 0; b < num_blocks; ++b) {
+        total += block_totals[b];
+    }
+    if (total <= 0.0) {
+        // every point is on a centroid already: any point will do
+        return (int)(random_fraction(random_state) * num_points);
+    }
+
+    double target = random_fraction(random_state) * total;
+    int block = 0;
+    while (block < num_blocks - 1 && target >= block_totals[block]) {
+        target -= block_totals[block];
+        block++;
+    }
+    int end = (block + 1) * KMEANSPP_BLOCK_SIZE < num_points ? (block + 1) * KMEANSPP_BLOCK_SIZE : num_points;
+    int selected = -1;
+    for (int n = block * KMEANSPP_BLOCK_SIZE; n < end; ++n) {
+        double weighted = weights == NULL ? distances[n] : weights[n] * distances[n];
+        if (weighted > 0.0) {
+            selected = n;
+            if (target < weighted) break;
+            target -= weighted;
+        }
+    }
+    // rounding can leave a little of the target over at the end of the block: take the last candidate
+    return selected >= 0 ? selected : block * KMEANSPP_BLOCK_SIZE;
+}
+
+/**
+ * k-means++ initialization (Arthur and Vassilvitskii): the first centroid is a point chosen at
+ * random and each next centroid is a point chosen with probability proportional to its squared
+ * distance (D^2) from the closest centroid chosen so far, which spreads the initial centroids
+ * out over the clusters and usually saves many iterations of the main loop.
+ *
+ * The distances are updated for each new centroid in parallel over fixed size blocks of points,
+ * with a vectorized loop in each block. The block totals are summed in order, so the choice of
+ * centroids only depends on the seed and not on the number of threads.
+ *
+ * @param dataset points to choose the centroids from
+ * @param weights weight of each point (e.g. how many points a candidate stands for) or NULL for all 1
+ * @param centroids centroids to be filled: the number of points gives the number of clusters
+ * @param seed seed for the pseudo random choices
+ */
+void kmeanspp_initialize_centroids(struct pointset *dataset, const double *weights, struct pointset *centroids,
+                                   unsigned int seed)
+{
+    int num_points = dataset->num_points;
+    int num_clusters = centroids->num_points;
+    int num_blocks = (num_points + KMEANSPP_BLOCK_SIZE - 1) / KMEANSPP_BLOCK_SIZE;
+    double *distances = (double *)malloc(num_points * sizeof(double));
+    double *block_totals = (double *)malloc(num_blocks * sizeof(double));
+    if (distances == NULL || block_totals == NULL) {
+        FAIL("Failed to allocate k-means++ distances for %d points", num_points);
+    }
+    const double *x = dataset->x_coords;
+    const double *y = dataset->y_coords;
+    uint64_t random_state = seed;
+
+    // the first centroid is chosen by weight alone
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < num_blocks; ++b) {
+        int end = (b + 1) * KMEANSPP_BLOCK_SIZE < num_points ? (b + 1) * KMEANSPP_BLOCK_SIZE : num_points;
+        double block_total = 0.0;
+        for (int n = b * KMEANSPP_BLOCK_SIZE; n < end; ++n) {
+            distances[n] = 1.0;
+            block_total += weights == NULL ? 1.0 : weights[n];
+        }
+        block_totals[b] = block_total;
+    }
+    int selected = select_weighted_point(distances, weights, block_totals, num_points, num_blocks, &random_state);
+    set_point(centroids, 0, x[selected], y[selected], IGNORE_CLUSTER_ID);
+    TRACE("k-means++ centroid 0 is point %d", selected);
+
+    for (int k = 1; k < num_clusters; ++k) {
+        double centroid_x = centroids->x_coords[k - 1];
+        double centroid_y = centroids->y_coords[k - 1];
+        bool first_update = k == 1;
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < num_blocks; ++b) {
+            int start = b * KMEANSPP_BLOCK_SIZE;
+            int end = start + KMEANSPP_BLOCK_SIZE < num_points ? start + KMEANSPP_BLOCK_SIZE : num_points;
+            double block_total = 0.0;
+            #pragma omp simd reduction(+:block_total)
+            for (int n = start; n < end; ++n) {
+                double diff_x = centroid_x - x[n];
+                double diff_y = centroid_y - y[n];
+                double distance = diff_x * diff_x + diff_y * diff_y;
+                double closest = first_update || distance < distances[n] ? distance : distances[n];
+                distances[n] = closest;
+                block_total += weights == NULL ? closest : weights[n] * closest;
+            }
+            block_totals[b] = block_total;
+        }
+        selected = select_weighted_point(distances, weights, block_totals, num_points, num_blocks, &random_state);
+        set_point(centroids, k, x[selected], y[selected], IGNORE_CLUSTER_ID);
+        TRACE("k-means++ centroid %d is point %d", k, selected);
+    }
+
+    free(distances);
+    free(block_totals);
+}
+
 /**
  * Initializes the given array of points to act as initial centroid "representatives" of the
  * clusters, by selecting the first num_clusters points in the dataset.
@@ -105,7 +690,8 @@ int simple_assign_clusters(struct pointset *dataset, struct pointset *centroids)
  *
  * WARNING: The kmeans can fail if there are equal points in the first K in the dataset
  *          such that two or more of the centroids are the same... try to avoid this in
- *          your dataset (TODO fix this later to skip equal centroids)
+ *          your dataset, or use --init kmeans++ which picks the centroids with the seeded
+ *          k-means++ method instead (see kmeanspp_initialize_centroids)
  *
  * @param dataset array of all points
  * @param centroids uninitialized array of centroids to be filled
@@ -117,7 +703,13 @@ void initialize_centroids(struct pointset* dataset, struct pointset *centroids)
         FAIL("There cannot be fewer points than clusters");
     }
 
-    copy_points(dataset, centroids, 0, centroids->num_points, false);
+    // k-means|| needs the points distributed over MPI nodes so here it falls back to k-means++
+    if (kmeans_config->init_method == init_kmeanspp || kmeans_config->init_method == init_kmeans_parallel) {
+        kmeanspp_initialize_centroids(dataset, NULL, centroids, kmeans_config->seed);
+    }
+    else {
+        copy_points(dataset, centroids, 0, centroids->num_points, false);
+    }
 }
 
 void simple_start_iteration_timing(struct kmeans_timing *timing)
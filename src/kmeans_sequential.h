@@ -1,9 +1,33 @@
 #ifndef KMEANS_SEQUENTIAL_H
 #define KMEANS_SEQUENTIAL_H
 
+#include <stdint.h>
+
+// per-cluster partial sums are packed as [sum_x, sum_y, count] for each cluster
+#define CLUSTER_SUMS_STRIDE 3
+// used to pad per-thread data so that threads do not share cache lines
+#define DOUBLES_PER_CACHE_LINE 8
+// with incremental centroid updates, recompute the cluster sums from scratch every this many iterations
+#define INCREMENTAL_REFRESH_ITERATIONS 16
+// points per block for the parallel k-means++ distance updates
+#define KMEANSPP_BLOCK_SIZE 4096
 
 extern void simple_calculate_centroids(struct pointset *dataset, struct pointset *centroids);
 extern int simple_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+extern int simple_assign_accumulate_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums);
+extern int simple_assign_move_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums);
+extern void simple_accumulate_clusters(struct pointset *dataset, double *cluster_sums, int num_clusters);
+extern void simple_update_centroids(double *cluster_sums, struct pointset *centroids);
+extern int omp_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+extern int omp_assign_accumulate_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums);
+extern int omp_assign_move_clusters(struct pointset *dataset, struct pointset *centroids, double *cluster_sums);
+extern void omp_accumulate_clusters(struct pointset *dataset, double *cluster_sums, int num_clusters);
+extern void omp_calculate_centroids(struct pointset *dataset, struct pointset *centroids);
+extern int omp_configure_threads(int num_threads);
+extern double cluster_inertia(struct pointset *dataset, struct pointset *centroids);
+extern double random_fraction(uint64_t *state);
+extern void kmeanspp_initialize_centroids(struct pointset *dataset, const double *weights, struct pointset *centroids,
+                                          unsigned int seed);
 extern void initialize_centroids(struct pointset* dataset, struct pointset *centroids);
 extern void simple_start_iteration_timing(struct kmeans_timing *timing);
 extern void simple_between_assignment_centroids(struct kmeans_timing *timing);
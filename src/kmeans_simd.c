@@ -0,0 +1,249 @@
+/**
+ * Vectorized assignment of points to the closest centroids.
+ *
+ * The kernels compute the distances from a block of points to every centroid directly
+ * on the x_coords/y_coords arrays of the pointset, with none of the bounds checks, logging
+ * or configuration lookups of point_distance() in the inner loop, and keep the running
+ * minimum distance and its cluster index for each point in vector registers.
+ *
+ * On x86 the widest instruction set the machine supports (AVX-512, AVX2) is chosen at
+ * runtime on first use. Everywhere else, and for the points left over at the end of the
+ * dataset, a blocked structure-of-arrays loop is used that the compiler can vectorize for
+ * whatever the target is.
+ *
+ * The results are identical to simple_assign_clusters: the same squared (or proper)
+ * distances are compared in the same order of clusters, with ties going to the lowest index.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+#include <omp.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_simd.h"
+#include "log.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KMEANS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// number of points handled together by the portable kernel
+#define SIMD_BLOCK 16
+
+typedef int (*assign_range_fn)(struct pointset *dataset, struct pointset *centroids, int start, int end);
+
+/**
+ * Portable kernel: for a block of points at a time, loop over the centroids and update the
+ * closest distances of all points in the block, which is a simple loop the compiler can vectorize.
+ */
+static int block_assign_range(struct pointset *dataset, struct pointset *centroids, int start, int end)
+{
+    const double *x = dataset->x_coords;
+    const double *y = dataset->y_coords;
+    const double *cx = centroids->x_coords;
+    const double *cy = centroids->y_coords;
+    int *cluster_ids = dataset->cluster_ids;
+    int num_clusters = centroids->num_points;
+    bool proper_distance = kmeans_config->proper_distance;
+    int cluster_changes = 0;
+
+    double min_distance[SIMD_BLOCK];
+    int closest_cluster[SIMD_BLOCK];
+    for (int block = start; block < end; block += SIMD_BLOCK) {
+        int block_size = end - block < SIMD_BLOCK ? end - block : SIMD_BLOCK;
+        for (int i = 0; i < block_size; ++i) {
+            min_distance[i] = DBL_MAX;
+            closest_cluster[i] = -1;
+        }
+        for (int k = 0; k < num_clusters; ++k) {
+            double centroid_x = cx[k];
+            double centroid_y = cy[k];
+            for (int i = 0; i < block_size; ++i) {
+                double diff_x = centroid_x - x[block + i];
+                double diff_y = centroid_y - y[block + i];
+                double distance = diff_x * diff_x + diff_y * diff_y;
+                if (proper_distance) {
+                    distance = sqrt(distance);
+                }
+                if (distance < min_distance[i]) {
+                    min_distance[i] = distance;
+                    closest_cluster[i] = k;
+                }
+            }
+        }
+        for (int i = 0; i < block_size; ++i) {
+            if (cluster_ids[block + i] != closest_cluster[i]) {
+                cluster_ids[block + i] = closest_cluster[i];
+                cluster_changes++;
+            }
+        }
+    }
+    return cluster_changes;
+}
+
+#ifdef KMEANS_SIMD_X86
+/**
+ * AVX2 kernel: 4 points per vector. The index of the closest cluster is kept as a double
+ * in a vector register so it can be blended with the same mask as the distances.
+ */
+__attribute__((target("avx2")))
+static int avx2_assign_range(struct pointset *dataset, struct pointset *centroids, int start, int end)
+{
+    const double *x = dataset->x_coords;
+    const double *y = dataset->y_coords;
+    const double *cx = centroids->x_coords;
+    const double *cy = centroids->y_coords;
+    int *cluster_ids = dataset->cluster_ids;
+    int num_clusters = centroids->num_points;
+    bool proper_distance = kmeans_config->proper_distance;
+    int cluster_changes = 0;
+
+    int n = start;
+    double closest[4];
+    for (; n + 4 <= end; n += 4) {
+        __m256d px = _mm256_loadu_pd(x + n);
+        __m256d py = _mm256_loadu_pd(y + n);
+        __m256d min_distance = _mm256_set1_pd(DBL_MAX);
+        __m256d closest_cluster = _mm256_set1_pd(-1.0);
+        for (int k = 0; k < num_clusters; ++k) {
+            __m256d diff_x = _mm256_sub_pd(_mm256_set1_pd(cx[k]), px);
+            __m256d diff_y = _mm256_sub_pd(_mm256_set1_pd(cy[k]), py);
+            __m256d distance = _mm256_add_pd(_mm256_mul_pd(diff_x, diff_x), _mm256_mul_pd(diff_y, diff_y));
+            if (proper_distance) {
+                distance = _mm256_sqrt_pd(distance);
+            }
+            __m256d closer = _mm256_cmp_pd(distance, min_distance, _CMP_LT_OQ);
+            min_distance = _mm256_blendv_pd(min_distance, distance, closer);
+            closest_cluster = _mm256_blendv_pd(closest_cluster, _mm256_set1_pd((double)k), closer);
+        }
+        _mm256_storeu_pd(closest, closest_cluster);
+        for (int i = 0; i < 4; ++i) {
+            int cluster = (int)closest[i];
+            if (cluster_ids[n + i] != cluster) {
+                cluster_ids[n + i] = cluster;
+                cluster_changes++;
+            }
+        }
+    }
+    return cluster_changes + block_assign_range(dataset, centroids, n, end);
+}
+
+/**
+ * AVX-512 kernel: 8 points per vector, with the comparisons in mask registers.
+ */
+__attribute__((target("avx512f")))
+static int avx512_assign_range(struct pointset *dataset, struct pointset *centroids, int start, int end)
+{
+    const double *x = dataset->x_coords;
+    const double *y = dataset->y_coords;
+    const double *cx = centroids->x_coords;
+    const double *cy = centroids->y_coords;
+    int *cluster_ids = dataset->cluster_ids;
+    int num_clusters = centroids->num_points;
+    bool proper_distance = kmeans_config->proper_distance;
+    int cluster_changes = 0;
+
+    int n = start;
+    double closest[8];
+    for (; n + 8 <= end; n += 8) {
+        __m512d px = _mm512_loadu_pd(x + n);
+        __m512d py = _mm512_loadu_pd(y + n);
+        __m512d min_distance = _mm512_set1_pd(DBL_MAX);
+        __m512d closest_cluster = _mm512_set1_pd(-1.0);
+        for (int k = 0; k < num_clusters; ++k) {
+            __m512d diff_x = _mm512_sub_pd(_mm512_set1_pd(cx[k]), px);
+            __m512d diff_y = _mm512_sub_pd(_mm512_set1_pd(cy[k]), py);
+            __m512d distance = _mm512_add_pd(_mm512_mul_pd(diff_x, diff_x), _mm512_mul_pd(diff_y, diff_y));
+            if (proper_distance) {
+                distance = _mm512_sqrt_pd(distance);
+            }
+            __mmask8 closer = _mm512_cmp_pd_mask(distance, min_distance, _CMP_LT_OQ);
+            min_distance = _mm512_mask_blend_pd(closer, min_distance, distance);
+            closest_cluster = _mm512_mask_blend_pd(closer, closest_cluster, _mm512_set1_pd((double)k));
+        }
+        _mm512_storeu_pd(closest, closest_cluster);
+        for (int i = 0; i < 8; ++i) {
+            int cluster = (int)closest[i];
+            if (cluster_ids[n + i] != cluster) {
+                cluster_ids[n + i] = cluster;
+                cluster_changes++;
+            }
+        }
+    }
+    return cluster_changes + block_assign_range(dataset, centroids, n, end);
+}
+#endif
+
+static assign_range_fn assign_range = NULL;
+static const char *isa_name = NULL;
+
+/**
+ * Choose the widest kernel the machine supports, once
+ */
+static void select_kernel()
+{
+    if (assign_range != NULL) return;
+    assign_range = block_assign_range;
+    isa_name = "portable";
+#ifdef KMEANS_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        assign_range = avx512_assign_range;
+        isa_name = "avx512";
+    }
+    else if (__builtin_cpu_supports("avx2")) {
+        assign_range = avx2_assign_range;
+        isa_name = "avx2";
+    }
+#endif
+    DEBUG("Selected the %s SIMD assignment kernel", isa_name);
+}
+
+/**
+ * Name of the instruction set used by the vectorized kernels on this machine
+ */
+const char *simd_isa_name()
+{
+    select_kernel();
+    return isa_name;
+}
+
+/**
+ * Vectorized version of simple_assign_clusters
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @return the number of points for which the cluster assignment was changed
+ */
+int simd_assign_clusters(struct pointset *dataset, struct pointset *centroids)
+{
+    select_kernel();
+    return assign_range(dataset, centroids, 0, dataset->num_points);
+}
+
+/**
+ * Vectorized and OpenMP parallel version of simple_assign_clusters: each thread runs the
+ * vectorized kernel over its own contiguous range of the points.
+ *
+ * @param dataset set of all points with current cluster assignments
+ * @param centroids set of current centroids
+ * @return the number of points for which the cluster assignment was changed
+ */
+int omp_simd_assign_clusters(struct pointset *dataset, struct pointset *centroids)
+{
+    select_kernel();
+    int num_points = dataset->num_points;
+    int cluster_changes = 0;
+    #pragma omp parallel reduction(+:cluster_changes)
+    {
+        int num_threads = omp_get_num_threads();
+        int thread = omp_get_thread_num();
+        int start = (int)((long)num_points * thread / num_threads);
+        int end = (int)((long)num_points * (thread + 1) / num_threads);
+        cluster_changes += assign_range(dataset, centroids, start, end);
+    }
+    return cluster_changes;
+}
@@ -0,0 +1,10 @@
+#ifndef KMEANS_SIMD_H
+#define KMEANS_SIMD_H
+
+#include "kmeans.h"
+
+extern int simd_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+extern int omp_simd_assign_clusters(struct pointset *dataset, struct pointset *centroids);
+extern const char *simd_isa_name();
+
+#endif
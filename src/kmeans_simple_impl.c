@@ -1,19 +1,42 @@
 /**
  * Simple Sequential Implementation of the K-Means Lloyds Algorithm
+ *
+ * With --threads greater than 1 the assignment and centroid steps use the OpenMP kernels.
+ * --simd, --grid and --single-pass/--incremental are mutually exclusive choices of assignment
+ * kernel (validate_config refuses combinations), and without any of them the plain kernel is used.
+ * With --single-pass the centroid sums are accumulated during assignment.
+ * With --simd the vectorized assignment kernels are used.
+ * With --grid only the candidate centroids from a grid index are compared.
+ * With --incremental the cluster sums are kept between iterations and only the points that
+ * change cluster are moved between them, with a full single pass every INCREMENTAL_REFRESH_ITERATIONS.
  */
 #include "kmeans.h"
 #include "kmeans_support.h"
 #include "kmeans_sequential.h"
+#include "kmeans_simd.h"
+#include "kmeans_grid.h"
 #include "log.h"
 
+const int engine_options = ENGINE_SINGLE_PASS | ENGINE_SIMD | ENGINE_GRID | ENGINE_INCREMENTAL;
 int num_points_total = 0;
+bool threaded = false; // true to use the OpenMP kernels when more than one thread is requested
+int assignments = 0;   // number of calls to assign_clusters, for the incremental refresh
 
 struct pointset main_dataset;
 struct pointset centroids;
+double *cluster_sums; // [sum_x, sum_y, count] per cluster from the single pass or incremental kernels
 
 void initialize(int max_points, struct kmeans_metrics *metrics)
 {
     metrics->num_processors=1; // sequential - always one processor
+    if (kmeans_config->num_threads > 1) {
+        threaded = true;
+        metrics->num_threads = omp_configure_threads(kmeans_config->num_threads);
+        INFO("Using OpenMP kernels with %d threads", metrics->num_threads);
+    }
+    if (kmeans_config->simd) {
+        INFO("Using %s SIMD assignment kernel", simd_isa_name());
+    }
     // for root we actually load the dataset, for others we just return the empty one
     allocate_pointset_points(&main_dataset, max_points);
     DEBUG("Allocated %d point space", max_points);
@@ -31,7 +54,30 @@ void initialize(int max_points, struct kmeans_metrics *metrics)
 int assign_clusters()
 {
     TRACE("Starting assign_clusters with %d datapoints", main_dataset.num_points);
-    int total_reassignments = simple_assign_clusters(&main_dataset, &centroids);
+    int total_reassignments;
+    bool refresh = assignments++ % INCREMENTAL_REFRESH_ITERATIONS == 0;
+    if (kmeans_config->incremental && !refresh) {
+        // only the points that change cluster are moved between the sums kept from the last iteration
+        total_reassignments = threaded ? omp_assign_move_clusters(&main_dataset, &centroids, cluster_sums)
+                                       : simple_assign_move_clusters(&main_dataset, &centroids, cluster_sums);
+    }
+    else if (kmeans_config->single_pass || kmeans_config->incremental) {
+        // the sums for the new centroids are accumulated in the same pass
+        total_reassignments = threaded ? omp_assign_accumulate_clusters(&main_dataset, &centroids, cluster_sums)
+                                       : simple_assign_accumulate_clusters(&main_dataset, &centroids, cluster_sums);
+    }
+    else if (kmeans_config->simd) {
+        total_reassignments = threaded ? omp_simd_assign_clusters(&main_dataset, &centroids)
+                                       : simd_assign_clusters(&main_dataset, &centroids);
+    }
+    else if (kmeans_config->grid) {
+        total_reassignments = threaded ? omp_grid_assign_clusters(&main_dataset, &centroids)
+                                       : grid_assign_clusters(&main_dataset, &centroids);
+    }
+    else {
+        total_reassignments = threaded ? omp_assign_clusters(&main_dataset, &centroids)
+                                       : simple_assign_clusters(&main_dataset, &centroids);
+    }
     TRACE("Leaving assign_clusters with %d changes", total_reassignments);
     return total_reassignments;
 }
@@ -43,13 +89,25 @@ int assign_clusters()
 void calculate_centroids()
 {
     TRACE("Starting calculate_centroids");
-    simple_calculate_centroids(&main_dataset, &centroids);
+    if (kmeans_config->single_pass || kmeans_config->incremental) {
+        simple_update_centroids(cluster_sums, &centroids);
+    }
+    else if (threaded) {
+        omp_calculate_centroids(&main_dataset, &centroids);
+    }
+    else {
+        simple_calculate_centroids(&main_dataset, &centroids);
+    }
     TRACE("Leaving calculate_centroids");
 }
 
 void initialize_representatives(int num_clusters)
 {
     allocate_pointset_points(&centroids, num_clusters);
+    cluster_sums = (double *)malloc(num_clusters * CLUSTER_SUMS_STRIDE * sizeof(double));
+    if (cluster_sums == NULL) {
+        FAIL("Failed to allocate cluster sums for %d clusters", num_clusters);
+    }
     initialize_centroids(&main_dataset, &centroids);
 }
 
@@ -99,6 +157,7 @@ void run(int max_iterations, struct kmeans_timing *timing)
 void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
 {
     metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
     main_finalize(&main_dataset, metrics, timing);
 }
 
@@ -0,0 +1,339 @@
+/**
+ * Streaming implementation of K-Means that never holds the whole dataset in memory
+ *
+ * The input is read --chunk-size points at a time into the same pointset, so the memory
+ * depends on the chunk size and K rather than on the number of points, and the clustering
+ * starts with the first chunk instead of after the whole file is parsed.
+ *
+ * The centroids are initialized from the first chunk (with --init as usual: kmeans++ gives
+ * much better centroids than the first K points when the file is ordered). The first
+ * iteration is an online pass: each chunk is assigned to the current centroids and every
+ * centroid is then moved to the mean of all the points it has been given so far (MacQueen's
+ * update, one chunk at a time). The following iterations are refinement passes: full Lloyd
+ * iterations that re-read the file, assign each chunk and accumulate the cluster sums, until
+ * no centroid moves or --iterations passes have been made (-i 2 for a single refinement pass).
+ *
+ * When the whole input fits in one chunk the online pass is the first Lloyd iteration, so the
+ * clustering is the same as kmeans_simple.
+ *
+ * The cluster of each point is not kept between passes: a last pass after the timed loop
+ * assigns each chunk to the final centroids to write the output, compare with the test file
+ * and sum the inertia, one chunk at a time.
+ */
+#include <float.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "log.h"
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+bool threaded = false; // true to use the OpenMP kernels when more than one thread is requested
+int dimensions = 0;    // number of headers in the input file
+int iteration = 0;
+int moved_centroids = 0; // number of centroids moved by the last refinement pass
+
+FILE *stream_file;        // input file, open from the initialization to the end of the online pass
+struct pointset chunk;    // the points of the current chunk
+struct pointset centroids;
+struct pointset old_centroids;
+double *centroid_weights; // per centroid: number of points merged into it by the online pass
+double *cluster_sums;     // [sum_x, sum_y, count] per cluster over a refinement pass
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    if (kmeans_config->num_threads > 1) {
+        threaded = true;
+        metrics->num_threads = omp_configure_threads(kmeans_config->num_threads);
+        INFO("Using OpenMP kernels with %d threads", metrics->num_threads);
+    }
+    // only one chunk of the dataset is ever in memory
+    allocate_pointset_points(&chunk, kmeans_config->chunk_size);
+    DEBUG("Allocated %d point space for chunks of up to %d points (max %d points in total)",
+          kmeans_config->chunk_size, kmeans_config->chunk_size, max_points);
+}
+
+/**
+ * Read the next chunk of points, stopping at the max points from -n
+ *
+ * @param file input file positioned after the headers or the last chunk
+ * @param points_read number of points already read from the file in this pass
+ * @return the number of points in the chunk: 0 at the end of the input
+ */
+static int read_chunk(FILE *file, int points_read)
+{
+    int chunk_size = kmeans_config->max_points - points_read;
+    if (chunk_size > kmeans_config->chunk_size) {
+        chunk_size = kmeans_config->chunk_size;
+    }
+    if (chunk_size <= 0) {
+        chunk.num_points = 0;
+        return 0;
+    }
+    // the chunk pointset is reused: its size is reset to the allocated size before reading
+    chunk.num_points = kmeans_config->chunk_size;
+    return read_csv_points(file, &chunk, chunk_size, dimensions);
+}
+
+/**
+ * Assign every point of the current chunk to its closest centroid
+ */
+static void assign_chunk()
+{
+    if (threaded) {
+        omp_assign_clusters(&chunk, &centroids);
+    }
+    else {
+        simple_assign_clusters(&chunk, &centroids);
+    }
+}
+
+/**
+ * Initialize the centroids from the first chunk, which is kept for the online pass
+ */
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    allocate_pointset_points(&old_centroids, num_clusters);
+    centroid_weights = (double *)calloc(num_clusters, sizeof(double));
+    cluster_sums = (double *)malloc(num_clusters * CLUSTER_SUMS_STRIDE * sizeof(double));
+    if (centroid_weights == NULL || cluster_sums == NULL) {
+        FAIL("Failed to allocate the cluster sums for %d clusters", num_clusters);
+    }
+
+    stream_file = open_dataset_stream(&dimensions);
+    int num_points = read_chunk(stream_file, 0);
+    if (num_points < num_clusters) {
+        FAIL("The first chunk has %d points: at least %d are needed to initialize the centroids "
+             "(increase --chunk-size)", num_points, num_clusters);
+    }
+    initialize_centroids(&chunk, &centroids);
+}
+
+/**
+ * Online pass over the whole file: the first chunk is already in memory. Each chunk is
+ * assigned, then each centroid moves to the mean of every point merged into it so far.
+ *
+ * @return the number of points in the dataset
+ */
+static int online_pass()
+{
+    int num_clusters = centroids.num_points;
+    int points_read = 0;
+    int num_chunks = 0;
+    do {
+        assign_chunk();
+        for (int i = 0; i < num_clusters * CLUSTER_SUMS_STRIDE; ++i) {
+            cluster_sums[i] = 0.0;
+        }
+        for (int n = 0; n < chunk.num_points; ++n) {
+            double *sums = cluster_sums + chunk.cluster_ids[n] * CLUSTER_SUMS_STRIDE;
+            sums[0] += chunk.x_coords[n];
+            sums[1] += chunk.y_coords[n];
+            sums[2] += 1.0;
+        }
+        // weighted mean of the old centroid and the new points of the cluster
+        for (int k = 0; k < num_clusters; ++k) {
+            double *sums = cluster_sums + k * CLUSTER_SUMS_STRIDE;
+            if (sums[2] > 0) {
+                double weight = centroid_weights[k] + sums[2];
+                double x = (centroids.x_coords[k] * centroid_weights[k] + sums[0]) / weight;
+                double y = (centroids.y_coords[k] * centroid_weights[k] + sums[1]) / weight;
+                set_point(&centroids, k, x, y, IGNORE_CLUSTER_ID);
+                centroid_weights[k] = weight;
+            }
+        }
+        points_read += chunk.num_points;
+        num_chunks++;
+    } while (read_chunk(stream_file, points_read) > 0);
+    fclose(stream_file);
+    stream_file = NULL;
+    INFO("Online pass over %d points in %d chunks", points_read, num_chunks);
+    return points_read;
+}
+
+/**
+ * Refinement pass over the whole file: assign every chunk and accumulate the cluster sums
+ *
+ * @return the number of points in the dataset
+ */
+static int refinement_pass()
+{
+    int num_clusters = centroids.num_points;
+    for (int i = 0; i < num_clusters * CLUSTER_SUMS_STRIDE; ++i) {
+        cluster_sums[i] = 0.0;
+    }
+    FILE *file = open_dataset_stream(&dimensions);
+    int points_read = 0;
+    while (read_chunk(file, points_read) > 0) {
+        assign_chunk();
+        for (int n = 0; n < chunk.num_points; ++n) {
+            double *sums = cluster_sums + chunk.cluster_ids[n] * CLUSTER_SUMS_STRIDE;
+            sums[0] += chunk.x_coords[n];
+            sums[1] += chunk.y_coords[n];
+            sums[2] += 1.0;
+        }
+        points_read += chunk.num_points;
+    }
+    fclose(file);
+    return points_read;
+}
+
+/**
+ * One pass over the file: the online pass in the first iteration, then refinement passes.
+ *
+ * @return the number of clusters changed since the last pass: every cluster for the online
+ *         pass, then the centroids moved by the last refinement
+ */
+int assign_clusters()
+{
+    TRACE("Starting streaming pass %d", iteration);
+    int num_points = iteration == 0 ? online_pass() : refinement_pass();
+    int changes = iteration == 0 ? centroids.num_points : moved_centroids;
+    if (iteration == 0) {
+        num_points_total = num_points;
+    }
+    iteration++;
+    TRACE("Leaving assign_clusters after %d points with %d changed clusters", num_points, changes);
+    return changes;
+}
+
+/**
+ * After a refinement pass, calculates new centroids from the cluster sums and counts the
+ * centroids that moved. The online pass has already moved the centroids.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    int num_clusters = centroids.num_points;
+    if (iteration == 1) {
+        // the online pass cannot be the last one
+        moved_centroids = num_clusters;
+        return;
+    }
+    copy_points(&centroids, &old_centroids, 0, num_clusters, false);
+    simple_update_centroids(cluster_sums, &centroids);
+    moved_centroids = 0;
+    for (int k = 0; k < num_clusters; ++k) {
+        if (centroids.x_coords[k] != old_centroids.x_coords[k] || centroids.y_coords[k] != old_centroids.y_coords[k]) {
+            moved_centroids++;
+        }
+    }
+    DEBUG("Refinement pass %d moved %d centroids", iteration - 1, moved_centroids);
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    // no centroid moved in the last pass so the next assignment would be the same
+    if ((iterations > 0 && moved_centroids == 0) || iterations >= max_iterations) {
+        INFO("Done with %d moved centroids after %d passes", moved_centroids, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+}
+
+/**
+ * Last pass over the file: assign each chunk to the final centroids, write it to the output,
+ * compare it with the same points of the test file and add up the inertia.
+ */
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    FILE *out_file = NULL;
+    if (kmeans_config->out_file) {
+        INFO("Writing output to %s\n", kmeans_config->out_file);
+        out_file = fopen(kmeans_config->out_file, "w");
+        if (!out_file) {
+            FAIL("Cannot write to the output file at %s\n", kmeans_config->out_file);
+        }
+    }
+    FILE *test_file = NULL;
+    struct pointset test_chunk;
+    int test_dimensions = 0;
+    static char *test_headers[3];
+    if (kmeans_config->test_file) {
+        char *test_file_name = valid_file('t', kmeans_config->test_file);
+        INFO("Comparing results against test file: %s\n", kmeans_config->test_file);
+        test_file = fopen(test_file_name, "r");
+        if (!test_file) {
+            FAIL("Cannot read the test file at %s", test_file_name);
+        }
+        test_dimensions = csvheaders(test_file, test_headers);
+        allocate_pointset_points(&test_chunk, kmeans_config->chunk_size);
+        metrics->test_result = 1;
+    }
+
+    FILE *file = open_dataset_stream(&dimensions);
+    if (out_file) {
+        write_dataset_headers(out_file);
+    }
+    double inertia = 0.0;
+    int points_read = 0;
+    while (read_chunk(file, points_read) > 0) {
+        assign_chunk();
+        inertia += cluster_inertia(&chunk, &centroids);
+        if (out_file) {
+            print_points(out_file, &chunk, NULL);
+        }
+        if (test_file && metrics->test_result == 1) {
+            test_chunk.num_points = kmeans_config->chunk_size;
+            int num_test_points = read_csv_points(test_file, &test_chunk, chunk.num_points, test_dimensions);
+            if (num_test_points < chunk.num_points) {
+                WARN("Test failed. The test dataset has only %d records, but needs at least %d",
+                     points_read + num_test_points, num_points_total);
+                metrics->test_result = -1;
+            }
+            else {
+                metrics->test_result = compare_test_points(&test_chunk, &chunk, points_read);
+            }
+        }
+        points_read += chunk.num_points;
+    }
+    fclose(file);
+    if (out_file) {
+        fclose(out_file);
+    }
+    if (test_file) {
+        fclose(test_file);
+        free(test_chunk.x_coords);
+        free(test_chunk.y_coords);
+        free(test_chunk.cluster_ids);
+    }
+
+    metrics->num_points = num_points_total;
+    metrics->inertia = inertia;
+    main_report(metrics, timing);
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <math.h>
@@ -10,6 +11,12 @@
 #include "csvhelper.h"
 #include "log.h"
 
+// columns added since the first version go after test_results so that older metrics files keep lining up
+#define METRICS_HEADERS "label,used_iterations,total_seconds,assignments_seconds," \
+                        "centroids_seconds,max_iteration_seconds,num_points," \
+                        "num_clusters,max_iterations,num_processors,test_results," \
+                        "num_threads,init_method,init_seconds,inertia,load_seconds"
+
 
 /**
  * Allocate points in a pointset struct that already exists
@@ -209,7 +216,9 @@ void print_points(FILE *out, struct pointset *dataset, const char *label) {
         label = "";
     }
     for (int i = 0; i < dataset->num_points; ++i) {
-        fprintf(out, "%s%s,cluster_%d\n", label, p_to_s(dataset, i), dataset->cluster_ids[i]);
+        // the format of p_to_s without a string allocated for every point
+        fprintf(out, "%s%.7f,%.7f,cluster_%d\n", label, dataset->x_coords[i], dataset->y_coords[i],
+                dataset->cluster_ids[i]);
     }
 }
 
@@ -261,10 +270,7 @@ void print_headers(FILE *out, char **headers, int dimensions) {
  */
 void print_metrics_headers(FILE *out)
 {
-    fprintf(out, "label,used_iterations,total_seconds,assignments_seconds,"
-                 "centroids_seconds,max_iteration_seconds,num_points,"
-                 "num_clusters,max_iterations,num_processors,"
-                 "test_results\n");
+    fprintf(out, "%s\n", METRICS_HEADERS);
 }
 
 /**
@@ -283,12 +289,12 @@ void print_metrics(FILE *out, struct kmeans_metrics *metrics)
             test_results = "FAILED!";
             break;
     }
-    fprintf(out, "%s,%d,%f,%f,%f,%f,%d,%d,%d,%d,%s\n",
+    fprintf(out, "%s,%d,%f,%f,%f,%f,%d,%d,%d,%d,%s,%d,%s,%f,%f,%f\n",
             metrics->label, metrics->used_iterations, metrics->total_seconds,
             metrics->assignment_seconds, metrics->centroids_seconds, metrics->max_iteration_seconds,
             metrics->num_points, metrics->num_clusters, metrics->max_iterations,
-            metrics->num_processors,
-            test_results);
+            metrics->num_processors, test_results, metrics->num_threads,
+            metrics->init_method, metrics->init_seconds, metrics->inertia, metrics->load_seconds);
 }
 
 /**
@@ -313,9 +319,14 @@ void summarize_metrics(FILE *out, struct kmeans_metrics *metrics)
                  "Total seconds   : %f\n"
                  "Iterations      : %d\n"
                  "Num Processors  : %d\n"
+                 "Num Threads     : %d\n"
+                 "Initialization  : %s (%f seconds)\n"
+                 "Inertia         : %f\n"
+                 "Load seconds    : %f\n"
                  "Test            : %s\n",
             metrics->label, metrics->num_points, metrics->num_clusters, metrics->total_seconds,
-            metrics->used_iterations, metrics->num_processors, test_results);
+            metrics->used_iterations, metrics->num_processors, metrics->num_threads,
+            metrics->init_method, metrics->init_seconds, metrics->inertia, metrics->load_seconds, test_results);
 }
 
 /**
@@ -331,9 +342,27 @@ void summarize_metrics(FILE *out, struct kmeans_metrics *metrics)
  */
 int read_csv(FILE* csv_file, struct pointset *dataset, int max_points, char *headers[], int *dimensions)
 {
-    char *line;
     *dimensions = csvheaders(csv_file, headers);
-    int max_fields = *dimensions > 2 ? 3 : 2; // max is 2 unless there is a cluster in which case 3
+    int count = read_csv_points(csv_file, dataset, max_points, *dimensions);
+    fclose(csv_file);
+    return count;
+}
+
+/**
+ * Read the next points (after the headers) from a CSV file that is left open, so that a large
+ * file can be read in chunks into the same pointset.
+ *
+ * @param csv_file file pointer to the input file, positioned after the headers or the last point read
+ * @param dataset pre-allocated dataset into which to read the points from index 0
+ * @param max_points max number of points to read
+ * @param dimensions number of headers
+ *
+ * @return number of actual points read from the file: 0 at the end of the file
+ */
+int read_csv_points(FILE* csv_file, struct pointset *dataset, int max_points, int dimensions)
+{
+    char *line;
+    int max_fields = dimensions > 2 ? 3 : 2; // max is 2 unless there is a cluster in which case 3
     int count = 0;
     while (count < max_points && (line = csvgetline(csv_file)) != NULL) {
         int num_fields = csvnfield(); // fields on the line
@@ -344,6 +373,8 @@ int read_csv(FILE* csv_file, struct pointset *dataset, int max_points, char *hea
 #endif
         if (num_fields < 2) {
             printf("Warning: found non-empty trailing line. Will stop reading points now: %s", line);
+            // skip the rest of the file so that the next chunk is empty
+            fseek(csv_file, 0, SEEK_END);
             break;
         }
         else {
@@ -352,7 +383,7 @@ int read_csv(FILE* csv_file, struct pointset *dataset, int max_points, char *hea
             char *y_string = csvfield(1);
             set_point(dataset, count, strtod(x_string, NULL), strtod(y_string, NULL), NO_CLUSTER_ID);
 
-            if (num_fields > 2 && *dimensions > 2) {
+            if (num_fields > 2 && dimensions > 2) {
                 char *cluster_string = csvfield(2);
                 int cluster;
                 char prefix[200];
@@ -362,7 +393,6 @@ int read_csv(FILE* csv_file, struct pointset *dataset, int max_points, char *hea
             count++;
         }
     }
-    fclose(csv_file);
 
     // update the dataset length to match the count
     dataset->num_points = count;
@@ -419,6 +449,27 @@ void write_csv_file(char *csv_file_name, struct pointset *dataset, char *headers
     write_csv(csv_file, dataset, headers, dimensions);
 }
 
+/**
+ * Warn when an existing metrics file has other headers, such as a file from an older version
+ * with fewer columns: the new rows are still appended but do not line up with its headers
+ */
+static void check_metrics_headers(char *metrics_file_name)
+{
+    char line[sizeof(METRICS_HEADERS) + 2];
+    FILE *metrics_file = fopen(metrics_file_name, "r");
+    if (!metrics_file) {
+        return;
+    }
+    bool matches = fgets(line, sizeof(line), metrics_file) != NULL &&
+                   strncmp(line, METRICS_HEADERS, sizeof(METRICS_HEADERS) - 1) == 0 &&
+                   (line[sizeof(METRICS_HEADERS) - 1] == '\n' || line[sizeof(METRICS_HEADERS) - 1] == '\r');
+    fclose(metrics_file);
+    if (!matches) {
+        WARN("The headers of the metrics file %s are not the current ones: the columns after test_results "
+             "may not line up (expected %s)", metrics_file_name, METRICS_HEADERS);
+    }
+}
+
 void write_metrics_file(char *metrics_file_name, struct kmeans_metrics *metrics) {
     char *mode = "a"; // default to append to the metrics file
     bool first_time = false;
@@ -428,6 +479,9 @@ void write_metrics_file(char *metrics_file_name, struct kmeans_metrics *metrics)
         first_time = true;
         mode = "w";
     }
+    else {
+        check_metrics_headers(metrics_file_name);
+    }
     FILE *metrics_file = fopen(metrics_file_name, mode);
     if (first_time) {
         print_metrics_headers(metrics_file);
@@ -467,28 +521,40 @@ int test_results(char *test_file_name, struct pointset *dataset)
         result = 1;
     }
     else {
-        for (int n = 0; n < num_points; ++n) {
-            if (same_point(testset, dataset, n)) {
-                if (!same_cluster(testset, dataset, n)) {
-                    // points match but assigned to different clusters
-                        WARN("Test failure at %d: (%s) result cluster: %d does not match test: %d\n",
-                                n + 1, p_to_s(dataset, n), dataset->cluster_ids[n], testset->cluster_ids[n]);
-                    result = -1;
-                    break; // give up comparing
-                }
-                else {
-                    TRACE("Test success at %d: (%s) clusters match: %d\n",
-                          n+1, p_to_s(dataset, n), dataset->cluster_ids[n]);
-                }
+        result = compare_test_points(testset, dataset, 0);
+    }
+    return result;
+}
+
+/**
+ * Compares the points of the dataset with the test points at the same positions
+ *
+ * @param testset test points with the expected clusters, at least as many as in the dataset
+ * @param dataset points with the resulting clusters
+ * @param first_line line number in the file of the first point, for the messages
+ * @return 1 if every point and cluster matches, otherwise -1 after the first failure
+ */
+int compare_test_points(struct pointset *testset, struct pointset *dataset, int first_line)
+{
+    for (int n = 0; n < dataset->num_points; ++n) {
+        if (same_point(testset, dataset, n)) {
+            if (!same_cluster(testset, dataset, n)) {
+                // points match but assigned to different clusters
+                    WARN("Test failure at %d: (%s) result cluster: %d does not match test: %d\n",
+                            first_line + n + 1, p_to_s(dataset, n), dataset->cluster_ids[n], testset->cluster_ids[n]);
+                return -1; // give up comparing
             }
             else {
-                // points themselves are different
-                WARN("Test failure at %d: %s does not match test point: %s\n",
-                     n+1, p_to_s(dataset, n), p_to_s(testset, n));
-                result = -1;
-                break; // give up comparing
+                TRACE("Test success at %d: (%s) clusters match: %d\n",
+                      first_line + n + 1, p_to_s(dataset, n), dataset->cluster_ids[n]);
             }
         }
+        else {
+            // points themselves are different
+            WARN("Test failure at %d: %s does not match test point: %s\n",
+                 first_line + n + 1, p_to_s(dataset, n), p_to_s(testset, n));
+            return -1; // give up comparing
+        }
     }
-    return result;
+    return 1;
 }
@@ -34,6 +34,7 @@ extern double point_distance(struct pointset *pointset1, int index1, struct poin
 extern const char *p_to_s(struct pointset *dataset, int index);
 extern double euclidean_distance(double x2, double y2, double x1, double y1);
 extern void kmeans_usage();
+extern void check_engine_options(struct kmeans_config *config, int supported);
 extern void print_points(FILE *out, struct pointset *dataset, const char *label);
 extern void print_headers(FILE *out, char **headers, int dimensions);
 extern void print_metrics_headers(FILE *out);
@@ -45,6 +46,7 @@ extern void print_metrics(FILE *out, struct kmeans_metrics *metrics);
 extern void summarize_metrics(FILE *out, struct kmeans_metrics *metrics);
 extern int read_csv_file(char* csv_file_name, struct pointset *dataset, int max_points, char *headers[], int *dimensions);
 extern int read_csv(FILE* csv_file, struct pointset *dataset, int max_points, char *headers[], int *dimensions);
+extern int read_csv_points(FILE* csv_file, struct pointset *dataset, int max_points, int dimensions);
 extern void write_csv_file(char *csv_file_name, struct pointset *dataset, char *headers[], int dimensions);
 extern void write_csv(FILE *csv_file, struct pointset *dataset, char *headers[], int dimensions);
 
@@ -52,7 +54,11 @@ extern void write_metrics_file(char *metrics_file_name, struct kmeans_metrics *m
 
 extern char* valid_file(char opt, char *filename);
 extern int valid_count(char opt, char *arg);
+extern unsigned int valid_seed(char *arg);
+extern const char *init_method_name(enum init_method_t init_method);
+extern enum init_method_t valid_init_method(char *arg);
 
 extern int test_results(char *test_file_name, struct pointset *dataset);
+extern int compare_test_points(struct pointset *testset, struct pointset *dataset, int first_line);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,360 @@
+/**
+ * Yinyang implementation of the K-Means Lloyds Algorithm, for large numbers of clusters
+ *
+ * The centroids are split into G = K/10 groups (by clustering the initial centroids) and each
+ * point keeps an upper bound on the distance to its assigned centroid and one lower bound per
+ * group on the distance to every other centroid in that group. Each iteration:
+ *  - global filter: a point whose upper bound is below all its group bounds keeps its cluster
+ *  - group filter: only the groups whose lower bound is below the upper bound are searched
+ *  - local filter: within a searched group, a centroid is skipped when the group bound from the
+ *    last iteration, less the distance that centroid moved, is still above the upper bound
+ * so the cost per iteration is far below O(N x K) once the centroids settle, with O(N x G) memory.
+ *
+ * The clustering is the same as the simple implementation (see kmeans_bounds.h).
+ */
+#include <string.h>
+#include "kmeans.h"
+#include "kmeans_support.h"
+#include "kmeans_sequential.h"
+#include "kmeans_bounds.h"
+#include "log.h"
+
+// centroids per group, and the iterations used to cluster the initial centroids into groups
+#define CENTROIDS_PER_GROUP 10
+#define GROUPING_ITERATIONS 5
+
+const int engine_options = ENGINE_NO_OPTIONS;
+int num_points_total = 0;
+int num_groups = 0;
+int iteration = 0;
+long skipped_total = 0; // distance calculations skipped over all iterations
+
+struct pointset main_dataset;
+struct pointset centroids;
+struct pointset old_centroids;
+int *centroid_group;     // group of each centroid
+int *group_start;        // group g has the centroids group_members[group_start[g]..group_start[g+1]-1]
+int *group_members;      // centroid indexes ordered by group
+double *drift;           // per centroid: upper bound on how far it moved in the last centroid calculation
+double *group_drift;     // per group: largest drift of the centroids in the group
+double *upper_bounds;    // per point: upper bound on the distance to the assigned centroid
+double *lower_bounds;    // per point and group (N x G): lower bound on the distance to the other centroids in the group
+
+void initialize(int max_points, struct kmeans_metrics *metrics)
+{
+    metrics->num_processors=1; // sequential - always one processor
+    allocate_pointset_points(&main_dataset, max_points);
+    DEBUG("Allocated %d point space", max_points);
+    num_points_total = load_dataset(&main_dataset);
+    INFO("Loaded main dataset with %d points (confirmation: %d)", num_points_total, main_dataset.num_points);
+}
+
+/**
+ * Group the initial centroids with a few Lloyds iterations over the centroids themselves, seeded
+ * with the first G centroids, then lay out the members of each group contiguously.
+ */
+static void group_centroids()
+{
+    int num_clusters = centroids.num_points;
+    struct pointset group_centers;
+    allocate_pointset_points(&group_centers, num_groups);
+    copy_points(&centroids, &group_centers, 0, num_groups, false);
+    for (int k = 0; k < num_clusters; ++k) {
+        centroids.cluster_ids[k] = NO_CLUSTER_ID;
+    }
+    for (int i = 0; i < GROUPING_ITERATIONS; ++i) {
+        simple_assign_clusters(&centroids, &group_centers);
+        simple_calculate_centroids(&centroids, &group_centers);
+    }
+
+    group_start = (int *)calloc(num_groups + 1, sizeof(int));
+    group_members = (int *)malloc(num_clusters * sizeof(int));
+    centroid_group = (int *)malloc(num_clusters * sizeof(int));
+    if (group_start == NULL || group_members == NULL || centroid_group == NULL) {
+        FAIL("Failed to allocate %d centroid groups", num_groups);
+    }
+    for (int k = 0; k < num_clusters; ++k) {
+        centroid_group[k] = centroids.cluster_ids[k];
+        group_start[centroid_group[k] + 1]++;
+    }
+    for (int g = 0; g < num_groups; ++g) {
+        group_start[g + 1] += group_start[g];
+    }
+    int next[num_groups];
+    memcpy(next, group_start, num_groups * sizeof(int));
+    for (int k = 0; k < num_clusters; ++k) {
+        group_members[next[centroid_group[k]]++] = k;
+    }
+    free(group_centers.x_coords);
+    free(group_centers.y_coords);
+    free(group_centers.cluster_ids);
+    DEBUG("Grouped %d centroids into %d groups", num_clusters, num_groups);
+}
+
+void initialize_representatives(int num_clusters)
+{
+    allocate_pointset_points(&centroids, num_clusters);
+    allocate_pointset_points(&old_centroids, num_clusters);
+    initialize_centroids(&main_dataset, &centroids);
+
+    num_groups = num_clusters / CENTROIDS_PER_GROUP;
+    if (num_groups < 1) num_groups = 1;
+    group_centroids();
+
+    drift = (double *)malloc(num_clusters * sizeof(double));
+    group_drift = (double *)malloc(num_groups * sizeof(double));
+    upper_bounds = (double *)malloc(num_points_total * sizeof(double));
+    lower_bounds = (double *)malloc((size_t)num_points_total * num_groups * sizeof(double));
+    if (drift == NULL || group_drift == NULL || upper_bounds == NULL || lower_bounds == NULL) {
+        FAIL("Failed to allocate Yinyang bounds for %d points and %d groups", num_points_total, num_groups);
+    }
+}
+
+/**
+ * First assignment: every distance is calculated, which sets all the bounds
+ */
+static int assign_all_clusters()
+{
+    int num_clusters = centroids.num_points;
+    int cluster_changes = 0;
+    double distances[num_clusters];
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        double min_distance = INFINITY;
+        int closest_cluster = -1;
+        for (int k = 0; k < num_clusters; ++k) {
+            distances[k] = squared_point_distance(&main_dataset, n, &centroids, k);
+            if (closer_cluster(distances[k], k, min_distance, closest_cluster)) {
+                min_distance = distances[k];
+                closest_cluster = k;
+            }
+        }
+        double *lower = lower_bounds + (size_t)n * num_groups;
+        for (int g = 0; g < num_groups; ++g) {
+            double group_min = INFINITY;
+            for (int m = group_start[g]; m < group_start[g + 1]; ++m) {
+                int k = group_members[m];
+                if (k != closest_cluster && distances[k] < group_min) group_min = distances[k];
+            }
+            lower[g] = lower_bound(group_min);
+        }
+        upper_bounds[n] = upper_bound(min_distance);
+        if (main_dataset.cluster_ids[n] != closest_cluster) {
+            main_dataset.cluster_ids[n] = closest_cluster;
+            cluster_changes++;
+        }
+    }
+    return cluster_changes;
+}
+
+/**
+ * Search the groups of point n that its bounds cannot rule out for a closer centroid and
+ * reset the upper bound and the bounds of the searched groups.
+ *
+ * @param assigned_distance squared distance from the point to its assigned centroid
+ * @param distance_calculations incremented by the distances calculated
+ * @return true if the point changed cluster
+ */
+static bool search_groups(int n, double assigned_distance, long *distance_calculations)
+{
+    double *lower = lower_bounds + (size_t)n * num_groups;
+    int assigned = main_dataset.cluster_ids[n];
+    double upper = upper_bound(assigned_distance);
+    int best = assigned;
+    double best_distance = assigned_distance;
+
+    // closest and second closest distance found in each searched group, as bounds
+    bool searched[num_groups];
+    int group_closest[num_groups];
+    double group_min[num_groups];
+    double group_second[num_groups];
+
+    for (int g = 0; g < num_groups; ++g) {
+        searched[g] = upper > lower[g];
+        if (!searched[g]) continue;
+        // the bound before this iteration's drift, for the local filter (never over-estimated)
+        double previous_lower = lower[g] + group_drift[g] * (1 - BOUND_SLACK);
+        group_closest[g] = -1;
+        group_min[g] = INFINITY;
+        group_second[g] = INFINITY;
+        for (int m = group_start[g]; m < group_start[g + 1]; ++m) {
+            int k = group_members[m];
+            double distance; // squared when calculated, otherwise already a bound
+            bool calculated = false;
+            if (k == assigned) {
+                distance = assigned_distance;
+                calculated = true;
+            }
+            else if (previous_lower - drift[k] >= upper) {
+                // cannot be closer: its old bound less its drift is still beyond the upper bound
+                distance = previous_lower - drift[k];
+            }
+            else {
+                distance = squared_point_distance(&main_dataset, n, &centroids, k);
+                (*distance_calculations)++;
+                calculated = true;
+                if (closer_cluster(distance, k, best_distance, best)) {
+                    best = k;
+                    best_distance = distance;
+                }
+            }
+            double bound = calculated ? lower_bound(distance) : distance;
+            if (bound < group_min[g]) {
+                group_second[g] = group_min[g];
+                group_min[g] = bound;
+                group_closest[g] = k;
+            }
+            else if (bound < group_second[g]) {
+                group_second[g] = bound;
+            }
+        }
+    }
+
+    for (int g = 0; g < num_groups; ++g) {
+        if (searched[g]) {
+            lower[g] = group_closest[g] == best ? group_second[g] : group_min[g];
+        }
+    }
+    upper_bounds[n] = upper_bound(best_distance);
+    if (best != assigned) {
+        // the old centroid is now one of the others in its group
+        int old_group = centroid_group[assigned];
+        double old_bound = lower_bound(assigned_distance);
+        if (!searched[old_group] && old_bound < lower[old_group]) {
+            lower[old_group] = old_bound;
+        }
+        main_dataset.cluster_ids[n] = best;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Assigns each point in the dataset to a cluster based on the distance from that cluster,
+ * searching only the groups of centroids that the bounds of the point cannot rule out.
+ *
+ * The return value indicates how many points were assigned to a _different_ cluster
+ * in this assignment process: this indicates how close the algorithm is to completion.
+ * When the return value is zero, no points changed cluster so the clustering is complete.
+ */
+int assign_clusters()
+{
+    TRACE("Starting Yinyang assign_clusters with %d datapoints", main_dataset.num_points);
+    int num_clusters = centroids.num_points;
+    int cluster_changes = 0;
+    long distance_calculations = 0;
+
+    if (iteration == 0) {
+        cluster_changes = assign_all_clusters();
+        distance_calculations = (long)main_dataset.num_points * num_clusters;
+    }
+    else {
+        for (int n = 0; n < main_dataset.num_points; ++n) {
+            double *lower = lower_bounds + (size_t)n * num_groups;
+            double global_lower = lower[0];
+            for (int g = 1; g < num_groups; ++g) {
+                if (lower[g] < global_lower) global_lower = lower[g];
+            }
+            if (upper_bounds[n] <= global_lower) {
+                continue;
+            }
+            // tighten the upper bound to the exact distance and check again
+            double assigned_distance = squared_point_distance(&main_dataset, n, &centroids, main_dataset.cluster_ids[n]);
+            distance_calculations++;
+            upper_bounds[n] = upper_bound(assigned_distance);
+            if (upper_bounds[n] <= global_lower) {
+                continue;
+            }
+            if (search_groups(n, assigned_distance, &distance_calculations)) cluster_changes++;
+        }
+    }
+
+    long all_distances = (long)main_dataset.num_points * num_clusters;
+    long skipped = all_distances > distance_calculations ? all_distances - distance_calculations : 0;
+    skipped_total += skipped;
+    INFO("Iteration %d skipped %ld of %ld distance calculations (%.1f%%)", iteration, skipped, all_distances,
+         all_distances > 0 ? 100.0 * skipped / all_distances : 0.0);
+    iteration++;
+    TRACE("Leaving assign_clusters with %d changes", cluster_changes);
+    return cluster_changes;
+}
+
+/**
+ * Calculates new centroids for the clusters of the given dataset by finding the
+ * mean x and y coordinates of the current members of the cluster for each cluster,
+ * then moves the bounds of every point by the distance the centroids moved.
+ */
+void calculate_centroids()
+{
+    TRACE("Starting calculate_centroids");
+    int num_clusters = centroids.num_points;
+    copy_points(&centroids, &old_centroids, 0, num_clusters, false);
+    simple_calculate_centroids(&main_dataset, &centroids);
+
+    centroid_drift(&old_centroids, &centroids, drift);
+    for (int g = 0; g < num_groups; ++g) {
+        group_drift[g] = 0.0;
+        for (int m = group_start[g]; m < group_start[g + 1]; ++m) {
+            if (drift[group_members[m]] > group_drift[g]) group_drift[g] = drift[group_members[m]];
+        }
+    }
+
+    for (int n = 0; n < main_dataset.num_points; ++n) {
+        double *lower = lower_bounds + (size_t)n * num_groups;
+        for (int g = 0; g < num_groups; ++g) {
+            // not clamped at zero so that search_groups can recover the bound before the drift
+            lower[g] -= group_drift[g];
+        }
+        upper_bounds[n] += drift[main_dataset.cluster_ids[n]];
+    }
+    TRACE("Leaving calculate_centroids");
+}
+
+bool is_done(int changes, int iterations, int max_iterations)
+{
+    if (changes == 0 || iterations >= max_iterations) {
+        INFO("Done with %d changes after %d iterations", changes, iterations);
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+void start_main_timing(struct kmeans_timing *timing)
+{
+    simple_start_main_timing(timing);
+}
+
+void start_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_start_iteration_timing(timing);
+}
+
+void between_assignment_centroids(struct kmeans_timing *timing)
+{
+    simple_between_assignment_centroids(timing);
+}
+
+void end_iteration_timing(struct kmeans_timing *timing)
+{
+    simple_end_iteration_timing(timing);
+}
+
+void end_main_timing(struct kmeans_timing *timing, int iterations)
+{
+    simple_end_main_timing(timing, iterations);
+}
+
+void run(int max_iterations, struct kmeans_timing *timing)
+{
+    main_loop(max_iterations, timing);
+    INFO("Skipped %ld of %ld distance calculations in %d iterations", skipped_total,
+         (long)main_dataset.num_points * centroids.num_points * iteration, iteration);
+}
+
+void finalize(struct kmeans_metrics *metrics, struct kmeans_timing *timing)
+{
+    metrics->num_points = num_points_total;
+    metrics->inertia = cluster_inertia(&main_dataset, &centroids);
+    main_finalize(&main_dataset, metrics, timing);
+}
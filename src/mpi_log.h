@@ -7,7 +7,7 @@
 extern int mpi_rank;
 extern enum log_level_t log_level;
 
-const char * const log_level_string[6] = {
+static const char * const log_level_string[6] = {
         [error] = "error",
         [warn] = "warn",
         [info]  = "info",
@@ -16,20 +16,21 @@ const char * const log_level_string[6] = {
         [trace]  = "trace"
 };
 
-void node_color()
+static inline void node_color()
 {
     int color = mpi_rank % 6 + 1;
     printf("\033[0;3%dm", color);
 }
 
-void reset_color()
+static inline void reset_color()
 {
     printf("\033[0m"); // reset terminal color
 }
 
-int mpi_log(int level, const char *fmt, ...)
+// use mpi_log(level, fmt, ...) so that levels above KMEANS_MAX_LOG_LEVEL are compiled out
+static inline int mpi_log_message(int level, const char *fmt, ...)
 {
-    if (log_level < level) return 0;
+    if ((int)log_level < level) return 0;
     FILE *out = stdout;
     if (level == error) {
         out = stderr;
@@ -45,4 +46,6 @@ int mpi_log(int level, const char *fmt, ...)
     return rc;
 }
 
+#define mpi_log(level, ...) ((int)(level) <= (int)KMEANS_MAX_LOG_LEVEL ? mpi_log_message(level, __VA_ARGS__) : 0)
+
 #endif
\ No newline at end of file